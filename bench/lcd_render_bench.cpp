@@ -0,0 +1,232 @@
+/**
+ * ---- LCD render benchmark ----
+ * Runs the HD44780 driver against the host LCD emulator and measures the simulated time each frame costs : the LCD
+ * initialization, a full screen of text, and game steps drawn the same way as disp_player() and disp_obstacles() in
+ * main.cpp, then the same steps drawn by shifting the display, as render_scroll() does.
+ *
+ * Usage: lcd_render_bench [-n steps] [-o directory] [-p] [-c]
+ *   -n steps      - number of game steps to draw (default 200)
+ *   -o directory  - capture every frame to directory/frames.txt
+ *   -p            - also capture every frame as directory/frame_NNNNN.ppm
+ *   -c            - print the statistics of every frame as CSV
+ *
+ * Exits with 1 if the driver sent a byte while the controller was still busy, or if a step is not shown the same way
+ * with and without scrolling.
+ *
+ * Built with -DLCD_I2C, the driver writes to the emulator through the PCF8574 model on the TWI bus : every frame waits
+ * for the bus to be idle, and the TWI transactions per frame are printed too.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../hd44780/HD44780.hpp"
+#include "../host/lcd_emulator.hpp"
+#ifdef LCD_I2C
+#include <avr/interrupt.h>
+#endif
+
+/**
+ * Struct: Summary
+ * Accumulates the statistics of the frames of a phase of the benchmark.
+ */
+struct Summary {
+    const char *name;
+    uint32_t frames;
+    uint64_t elapsed_ns, max_elapsed_ns, busy_ns;
+    uint32_t bytes, late;
+    uint32_t transactions, errors;
+};
+
+static bool csv = false;
+
+static void add(Summary *s, const LcdEmuFrame &f) {
+    s->frames++;
+    s->elapsed_ns += f.elapsed_ns;
+    if (f.elapsed_ns > s->max_elapsed_ns)
+        s->max_elapsed_ns = f.elapsed_ns;
+    s->busy_ns += f.busy_ns;
+    s->bytes += f.commands + f.data;
+    s->late += f.late;
+    if (csv)
+        printf("%s,%u,%.1f,%.1f,%u,%u,%u\n", s->name, (unsigned) f.index, f.elapsed_ns / 1e3, f.busy_ns / 1e3,
+               (unsigned) f.commands, (unsigned) f.data, (unsigned) f.late);
+}
+
+// Closes a frame once every byte written has reached the display
+static void end_frame(Summary *s) {
+    LCD_Flush();
+    add(s, LcdEmu_EndFrame());
+
+    LCD_QueueStats stats;
+    LCD_GetQueueStats(&stats);
+    s->transactions += stats.transactions;
+    s->errors += stats.errors;
+    LCD_ResetQueueStats();
+}
+
+static void print(const Summary &s) {
+    printf("%-8s frames=%-5u mean_elapsed_us=%-9.1f max_elapsed_us=%-9.1f mean_busy_us=%-9.1f mean_bytes=%-6.1f late=%u",
+           s.name, (unsigned) s.frames, s.elapsed_ns / 1e3 / s.frames, s.max_elapsed_ns / 1e3,
+           s.busy_ns / 1e3 / s.frames, (double) s.bytes / s.frames, (unsigned) s.late);
+#ifdef LCD_I2C
+    printf(" mean_transactions=%-5.1f errors=%u", (double) s.transactions / s.frames, (unsigned) s.errors);
+#endif
+    printf("\n");
+}
+
+static void disp(unsigned char x, unsigned char y, const char *s) {
+    char text[LCDEMU_LINE_LENGTH + 1];
+    strncpy(text, s, LCDEMU_LINE_LENGTH);
+    text[LCDEMU_LINE_LENGTH] = '\0';
+    LCD_GoTo(x, y);
+    LCD_WriteText(text);
+}
+
+static bool has(const int *posx, const int *posy, int count, int x, int y) {
+    for (int i = 0 ; i < count ; i++)
+        if (posx[i] == x && posy[i] == y)
+            return true;
+    return false;
+}
+
+// Writes a column of the screen at its place in DDRAM, the same way as disp_column() in main.cpp
+static void column(unsigned char offset, unsigned char x, char top, char bottom) {
+    unsigned char address = (offset + x) % HD44780_DDRAM_LINE_LENGTH;
+    LCD_GoTo(address, 0);
+    LCD_WriteData(top);
+    LCD_GoTo(address, 1);
+    LCD_WriteData(bottom);
+}
+
+static unsigned mismatches = 0;
+
+/**
+ * Draws game steps, with obstacles spawned every 3 to 6 steps on a random line. Without scrolling, the steps are drawn
+ * the same way as disp_player() and disp_obstacles() in main.cpp, and the visible screens are saved to 'screens'. With
+ * scrolling, they are drawn the same way as render_scroll(), and the visible screens are compared with the saved ones.
+ */
+static void play(Summary *summary, int steps, bool scrolling, char (*screens)[2][LCDEMU_COLUMNS + 1]) {
+    int posx[8], posy[8], count = 0, next = 0;
+    unsigned char offset = 0;
+    srandom(1);
+    for (int step = 0 ; step < steps ; step++) {
+        for (int i = 0 ; i < count ; i++)
+            posx[i]--;
+        if (count > 0 && posx[0] < 0) {
+            memmove(posx, posx + 1, (count - 1) * sizeof(int));
+            memmove(posy, posy + 1, (count - 1) * sizeof(int));
+            count--;
+        }
+
+        if (--next <= 0 && count < 8) {
+            posx[count] = 16;
+            posy[count] = random() & 1;
+            count++;
+            next = 3 + random() % 4;
+        }
+
+        char legs = step % 4 == 2 ? '|' : '>';
+        if (scrolling) {
+            // render_scroll()
+            LCD_ShiftLeft();
+            offset = (offset + 1) % HD44780_DDRAM_LINE_LENGTH;
+            column(offset, 15, has(posx, posy, count, 15, 0) ? '-' : ' ', has(posx, posy, count, 15, 1) ? '-' : ' ');
+            column(offset, 0, has(posx, posy, count, 0, 0) ? 'x' : 'o', has(posx, posy, count, 0, 1) ? 'X' : legs);
+        } else {
+            // disp_player()
+            disp(0, 0, " ");
+            disp(0, 1, " ");
+            disp(0, 0, "o");
+            disp(0, 1, legs == '|' ? "|" : ">");
+
+            // disp_obstacles()
+            disp(1, 0, "               ");
+            disp(1, 1, "               ");
+            for (int i = 0 ; i < count ; i++)
+                disp(posx[i], posy[i], posx[i] == 0 ? (posy[i] ? "X" : "x") : "-");
+        }
+
+        end_frame(summary);
+
+        for (int y = 0 ; y < 2 ; y++) {
+            char line[LCDEMU_COLUMNS + 1];
+            LcdEmu_Line(y, line);
+            if (!scrolling)
+                memcpy(screens[step][y], line, sizeof(line));
+            else if (memcmp(screens[step][y], line, sizeof(line)) != 0)
+                mismatches++;
+        }
+    }
+}
+
+int main(int argc, char **argv) {
+    int steps = 200;
+    const char *directory = NULL;
+    bool ppm = false;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "n:o:pc")) != -1) {
+        switch (opt) {
+            case 'n': steps = atoi(optarg); break;
+            case 'o': directory = optarg; break;
+            case 'p': ppm = true; break;
+            case 'c': csv = true; break;
+            default:
+                fprintf(stderr, "usage: %s [-n steps] [-o directory] [-p] [-c]\n", argv[0]);
+                return 2;
+        }
+    }
+
+#ifdef LCD_I2C
+    LcdEmu_AttachI2c(LCD_I2C_ADDRESS);
+    sei();
+#else
+    LcdEmu_AttachParallel();
+#endif
+    LcdEmu_Capture(directory, ppm);
+    if (csv)
+        printf("phase,frame,elapsed_us,busy_us,commands,data,late\n");
+
+    /* Initialization */
+    Summary init = { "init" };
+    LcdEmu_BeginFrame();
+    LCD_Initalize();
+    LCD_Clear();
+    end_frame(&init);
+
+    /* Text screen */
+    Summary text = { "text" };
+    disp(0, 0, "* Running Dino *");
+    disp(0, 1, "**  Press B4  **");
+    end_frame(&text);
+
+    /* Game steps, redrawing both lines, then shifting the display : both must show the same screens */
+    Summary game = { "game" }, scroll = { "scroll" };
+    char (*screens)[2][LCDEMU_COLUMNS + 1] = new char[steps][2][LCDEMU_COLUMNS + 1];
+    play(&game, steps, false, screens);
+    LCD_Clear();
+    LCD_Flush();
+    LCD_ResetQueueStats();
+    LcdEmu_BeginFrame();
+    play(&scroll, steps, true, screens);
+    delete[] screens;
+
+    LcdEmu_Capture(NULL, false);
+
+    if (!csv) {
+        print(init);
+        print(text);
+        if (game.frames > 0) {
+            print(game);
+            print(scroll);
+        }
+    }
+    if (mismatches > 0)
+        fprintf(stderr, "%u game steps are shown differently when scrolling\n", mismatches);
+    uint32_t failures = init.late + text.late + game.late + scroll.late + mismatches;
+    failures += init.errors + text.errors + game.errors + scroll.errors;
+    return failures > 0 ? 1 : 0;
+}
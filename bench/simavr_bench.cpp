@@ -0,0 +1,245 @@
+/**
+ * ---- simavr benchmark ----
+ * Runs the firmware, built with PROBES defined, on a simulated ATmega328p and measures the number of cycles spent in
+ * each phase marked in probe/probe.hpp : game steps, LCD rendering, USART messages, ...
+ *
+ * The buttons and the potentiometer are driven by a script, one event per line :
+ *   <time_ms> adc <millivolts>                        - sets the voltage of the potentiometer
+ *   <time_ms> press <B1..B4>                          - presses a button
+ *   <time_ms> release <B1..B4>                        - releases a button
+ *   <time_ms> every <period_ms> <hold_ms> <B1..B4>    - from then on, presses a button periodically
+ *   <time_ms> end                                     - stops the simulation
+ * Lines starting with '#' are ignored.
+ *
+ * Usage: simavr_bench firmware.elf script.txt [report.json]
+ * The report is written as JSON, to stdout if no file is given.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include <simavr/sim_avr.h>
+#include <simavr/sim_elf.h>
+#include <simavr/avr_ioport.h>
+#include <simavr/avr_adc.h>
+
+#include "../probe/probe.hpp"
+
+#define GPIOR0_ADDRESS 0x3E // data space address of GPIOR0
+#define MAX_EVENTS 256
+
+/**
+ * Struct: Event
+ * An event of the script.
+ */
+struct Event {
+    uint64_t time_ms;
+    enum { ADC, PRESS, RELEASE, EVERY, END } type;
+    int value; // millivolts, or button
+    uint64_t period_ms, hold_ms;
+};
+
+/**
+ * Struct: Probe
+ * Cycles measured for a phase of the firmware.
+ */
+struct Probe {
+    avr_cycle_count_t begin;
+    bool running;
+    uint64_t count, total, min, max;
+};
+
+static Probe probes[PROBE_COUNT];
+
+/**
+ * Called by simavr on every write to GPIOR0 : records the beginning or the end of a phase, or counts an event.
+ */
+static void on_probe(avr_t *avr, avr_io_addr_t addr, uint8_t value, void *param) {
+    avr->data[addr] = value;
+
+    uint8_t id = value & ~(PROBE_END_FLAG | PROBE_EVENT_FLAG);
+    if (id == 0 || id >= PROBE_COUNT)
+        return;
+
+    Probe *p = &probes[id];
+    if (value & PROBE_EVENT_FLAG) {
+        p->count++;
+    } else if (!(value & PROBE_END_FLAG)) {
+        p->begin = avr->cycle;
+        p->running = true;
+    } else if (p->running) {
+        uint64_t cycles = avr->cycle - p->begin;
+        p->running = false;
+        if (p->count == 0 || cycles < p->min)
+            p->min = cycles;
+        if (cycles > p->max)
+            p->max = cycles;
+        p->total += cycles;
+        p->count++;
+    }
+}
+
+static int parse_button(const char *s) {
+    if (s[0] == 'B' && s[1] >= '1' && s[1] <= '4')
+        return s[1] - '1'; // B1 is PIND0, ..., B4 is PIND3
+    return -1;
+}
+
+static int read_script(const char *path, Event *events) {
+    FILE *f = fopen(path, "r");
+    if (f == NULL) {
+        perror(path);
+        exit(2);
+    }
+
+    char line[256];
+    int n = 0;
+    while (fgets(line, sizeof(line), f) != NULL && n < MAX_EVENTS) {
+        char action[16], arg1[16] = "", arg2[16] = "", arg3[16] = "";
+        unsigned long long time_ms;
+        if (line[0] == '#' || sscanf(line, "%llu %15s %15s %15s %15s", &time_ms, action, arg1, arg2, arg3) < 2)
+            continue;
+
+        Event *e = &events[n];
+        memset(e, 0, sizeof(*e));
+        e->time_ms = time_ms;
+        if (strcmp(action, "adc") == 0) {
+            e->type = Event::ADC;
+            e->value = atoi(arg1);
+        } else if (strcmp(action, "press") == 0 || strcmp(action, "release") == 0) {
+            e->type = action[0] == 'p' ? Event::PRESS : Event::RELEASE;
+            e->value = parse_button(arg1);
+        } else if (strcmp(action, "every") == 0) {
+            e->type = Event::EVERY;
+            e->period_ms = strtoull(arg1, NULL, 10);
+            e->hold_ms = strtoull(arg2, NULL, 10);
+            e->value = parse_button(arg3);
+        } else if (strcmp(action, "end") == 0) {
+            e->type = Event::END;
+        } else {
+            fprintf(stderr, "%s: unknown action '%s'\n", path, action);
+            exit(2);
+        }
+        if (e->type == Event::EVERY && e->period_ms == 0) {
+            fprintf(stderr, "%s: the period must not be 0 in '%s'\n", path, line);
+            exit(2);
+        }
+        if (e->type != Event::ADC && e->type != Event::END && e->value < 0) {
+            fprintf(stderr, "%s: unknown button in '%s'\n", path, line);
+            exit(2);
+        }
+        n++;
+    }
+    fclose(f);
+    return n;
+}
+
+static void set_button(avr_t *avr, int button, bool pressed) {
+    // The buttons pull their pin low when pressed
+    avr_raise_irq(avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ('D'), button), pressed ? 0 : 1);
+}
+
+int main(int argc, char **argv) {
+    if (argc < 3) {
+        fprintf(stderr, "usage: %s firmware.elf script.txt [report.json]\n", argv[0]);
+        return 2;
+    }
+
+    Event events[MAX_EVENTS];
+    int nb_events = read_script(argv[2], events);
+
+    elf_firmware_t firmware;
+    memset(&firmware, 0, sizeof(firmware));
+    if (elf_read_firmware(argv[1], &firmware) != 0) {
+        fprintf(stderr, "%s: cannot read the firmware\n", argv[1]);
+        return 2;
+    }
+
+    avr_t *avr = avr_make_mcu_by_name("atmega328p");
+    if (avr == NULL) {
+        fprintf(stderr, "simavr does not support the atmega328p\n");
+        return 2;
+    }
+    avr_init(avr);
+    avr_load_firmware(avr, &firmware);
+    avr->frequency = 16000000;
+    avr->avcc = 5000;
+    avr->aref = 5000;
+
+    avr_register_io_write(avr, GPIOR0_ADDRESS, on_probe, NULL);
+    for (int button = 0 ; button < 4 ; button++)
+        set_button(avr, button, false);
+
+    // Periodic presses, in the same order as the events
+    bool periodic[MAX_EVENTS] = { false };
+    bool held[MAX_EVENTS] = { false };
+
+    int next = 0;
+    uint64_t end_ms = UINT64_MAX, last_ms = UINT64_MAX;
+    int state = cpu_Running;
+    while (state != cpu_Done && state != cpu_Crashed) {
+        uint64_t now_ms = avr->cycle / (avr->frequency / 1000);
+        if (now_ms == last_ms) {
+            state = avr_run(avr);
+            continue;
+        }
+        last_ms = now_ms;
+        if (now_ms >= end_ms)
+            break;
+
+        for ( ; next < nb_events && events[next].time_ms <= now_ms ; next++) {
+            Event *e = &events[next];
+            switch (e->type) {
+                case Event::ADC: avr_raise_irq(avr_io_getirq(avr, AVR_IOCTL_ADC_GETIRQ, ADC_IRQ_ADC0), e->value); break;
+                case Event::PRESS: set_button(avr, e->value, true); break;
+                case Event::RELEASE: set_button(avr, e->value, false); break;
+                case Event::EVERY: periodic[next] = true; break;
+                case Event::END: end_ms = e->time_ms; break;
+            }
+        }
+
+        for (int i = 0 ; i < next ; i++) {
+            if (!periodic[i])
+                continue;
+            Event *e = &events[i];
+            bool pressed = (now_ms - e->time_ms) % e->period_ms < e->hold_ms;
+            if (pressed != held[i]) {
+                set_button(avr, e->value, pressed);
+                held[i] = pressed;
+            }
+        }
+
+        state = avr_run(avr);
+    }
+
+    FILE *out = argc > 3 ? fopen(argv[3], "w") : stdout;
+    if (out == NULL) {
+        perror(argv[3]);
+        return 2;
+    }
+
+    static const char *names[] = PROBE_NAMES;
+    fprintf(out, "{\n  \"firmware\": \"%s\",\n  \"script\": \"%s\",\n", argv[1], argv[2]);
+    fprintf(out, "  \"frequency\": %u,\n  \"cycles\": %llu,\n  \"crashed\": %s,\n  \"probes\": {", (unsigned) avr->frequency,
+            (unsigned long long) avr->cycle, state == cpu_Crashed ? "true" : "false");
+    bool first = true;
+    for (int id = 1 ; id < PROBE_COUNT ; id++) {
+        Probe *p = &probes[id];
+        if (id >= PROBE_FIRST_EVENT) {
+            fprintf(out, ",\n    \"%s\": { \"count\": %llu }", names[id], (unsigned long long) p->count);
+            continue;
+        }
+        fprintf(out, "%s\n    \"%s\": { \"count\": %llu, \"total\": %llu, \"min\": %llu, \"mean\": %.1f, \"max\": %llu }",
+                first ? "" : ",", names[id], (unsigned long long) p->count, (unsigned long long) p->total,
+                (unsigned long long) p->min, p->count ? (double) p->total / p->count : 0.0,
+                (unsigned long long) p->max);
+        first = false;
+    }
+    fprintf(out, "\n  }\n}\n");
+    if (out != stdout)
+        fclose(out);
+
+    return state == cpu_Crashed ? 1 : 0;
+}
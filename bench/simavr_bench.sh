@@ -0,0 +1,26 @@
+#!/bin/sh
+# Builds the firmware with the probes enabled, runs it under simavr with a script of inputs, and writes the cycles
+# spent in each phase as JSON.
+#
+# Usage: bench/simavr_bench.sh [script] [report.json]
+# Requires avr-g++ (avr-libc) and simavr (libsimavr, with its headers).
+
+set -e
+
+ROOT=$(cd "$(dirname "$0")/.." && pwd)
+SCRIPT=${1:-$ROOT/bench/scripts/play.txt}
+REPORT=${2:-simavr_report.json}
+BUILD=${BUILD:-$ROOT/_bench_build}
+
+mkdir -p "$BUILD"
+
+avr-g++ -mmcu=atmega328p -DF_CPU=16000000UL -DPROBES -Os -std=gnu++11 -I"$ROOT" \
+    "$ROOT/main.cpp" "$ROOT/hd44780/HD44780.cpp" "$ROOT/uartLib/uart.cpp" "$ROOT/vector/vector.cpp" \
+    "$ROOT/led/led.cpp" "$ROOT/console/console.cpp" \
+    "$ROOT/clock/clock.cpp" "$ROOT/latency/latency.cpp" \
+    -o "$BUILD/dino.elf"
+
+${CXX:-g++} -O2 -std=c++11 "$ROOT/bench/simavr_bench.cpp" -lsimavr -lelf -o "$BUILD/simavr_bench"
+
+"$BUILD/simavr_bench" "$BUILD/dino.elf" "$SCRIPT" "$REPORT"
+echo "Report written to $REPORT"
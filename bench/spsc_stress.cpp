@@ -0,0 +1,107 @@
+/**
+ * ---- SPSC stress test ----
+ * Passes items from a producer thread to a consumer thread through the ring of spsc/spsc.hpp, as fast as they can, and
+ * checks that every item arrives once, in order and whole : an item is a sequence number and its complement, so an
+ * item read while it is being written shows up as well as a lost or repeated one. The ring is small, so the threads
+ * keep catching up with each other and the indices wrap around millions of times.
+ *
+ * Usage: spsc_stress [-n items] [-y]
+ *   -n items  - items to pass (default 200000000)
+ *   -y        - yield when the ring is full or empty instead of spinning, for a machine with a single core
+ *
+ * Exits with 1 if an item was lost, repeated, reordered or torn.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <thread>
+
+#include "../spsc/spsc.hpp"
+
+#define RING_SIZE 16
+
+/**
+ * Struct: Item
+ * An item of the test, bigger than the indices of the ring, so it cannot be written at once.
+ */
+struct Item {
+    uint64_t sequence;
+    uint64_t check;             // ~sequence
+};
+
+static Spsc<Item, RING_SIZE> ring;
+static uint64_t count = 200000000;
+static bool yield = false;
+static uint64_t full_waits = 0, empty_waits = 0;
+
+static double now_s() {
+    timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+static void produce() {
+    for (uint64_t i = 0 ; i < count ; i++) {
+        Item item = { i, ~i };
+        while (!ring.push(item)) {
+            full_waits++;
+            if (yield)
+                std::this_thread::yield();
+        }
+    }
+}
+
+/**
+ * Takes every item, and returns the number of items which were not the next one expected.
+ */
+static uint64_t consume() {
+    uint64_t errors = 0, expected = 0;
+    while (expected < count) {
+        Item item;
+        if (!ring.pop(&item)) {
+            empty_waits++;
+            if (yield)
+                std::this_thread::yield();
+            continue;
+        }
+        if (item.sequence != expected || item.check != ~expected) {
+            if (errors < 10)
+                fprintf(stderr, "item %llu : sequence %llu, check %llx\n", (unsigned long long) expected,
+                        (unsigned long long) item.sequence, (unsigned long long) item.check);
+            errors++;
+            expected = item.sequence; // resynchronize on the item received
+        }
+        expected++;
+    }
+    return errors;
+}
+
+int main(int argc, char **argv) {
+    int opt;
+    while ((opt = getopt(argc, argv, "n:y")) != -1) {
+        switch (opt) {
+            case 'n': count = strtoull(optarg, NULL, 0); break;
+            case 'y': yield = true; break;
+            default:
+                fprintf(stderr, "usage: %s [-n items] [-y]\n", argv[0]);
+                return 2;
+        }
+    }
+
+    double start = now_s();
+    std::thread producer(produce);
+    uint64_t errors = consume();
+    producer.join();
+    double elapsed = now_s() - start;
+
+    if (!ring.empty())
+        errors++;
+    printf("items=%llu elapsed_s=%.3f items_per_s=%.3g ns_per_item=%.1f full_waits=%llu empty_waits=%llu errors=%llu\n",
+           (unsigned long long) count, elapsed, count / elapsed, elapsed * 1e9 / count,
+           (unsigned long long) full_waits, (unsigned long long) empty_waits, (unsigned long long) errors);
+    return errors > 0 ? 1 : 0;
+}
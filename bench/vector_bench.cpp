@@ -0,0 +1,373 @@
+/**
+ * ---- vector benchmark ----
+ * Measures the operations of the vector library on the host : time per operation and number of allocations per
+ * operation, for several element sizes and vector lengths. The appends are also measured with the vector's memory
+ * coming from an arena, and from its inline storage. The removal of the first element is measured with VectorDelete
+ * and VectorSwapRemove, and the removal of every other element one element at a time with VectorDelete and in a single
+ * pass with VectorRemoveIf : none of them allocates, so their allocs/op is 0. The searches (one search of a present key per
+ * operation) are compared with lfind and bsearch, on vectors of ints. The cases which remove or sort the elements of
+ * a vector get it filled and disposed of outside of the measure, so only the removals and the sort are counted.
+ *
+ * Usage: vector_bench [-m min_ms]
+ *   -m min_ms - minimum duration of each measurement, in ms (default 50)
+ *
+ * The allocations are counted by wrapping the C library's malloc, realloc and free, so this benchmark only builds
+ * against glibc.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <search.h>
+
+#include "../vector/vector.h"
+
+/* --- Allocation counting --- */
+
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *__libc_realloc(void *ptr, size_t size);
+extern "C" void __libc_free(void *ptr);
+
+// volatile : the compiler takes the wrappers below for the builtin malloc and realloc, which do not touch it, and would
+// otherwise move its reads across the calls which allocate
+static volatile uint64_t allocations = 0;
+
+extern "C" void *malloc(size_t size) {
+    allocations++;
+    return __libc_malloc(size);
+}
+
+extern "C" void *realloc(void *ptr, size_t size) {
+    allocations++;
+    return __libc_realloc(ptr, size);
+}
+
+extern "C" void free(void *ptr) {
+    __libc_free(ptr);
+}
+
+// Declared by vector.h, defined by the firmware
+void debug(char *s) {
+    fprintf(stderr, "%s\n", s);
+}
+
+/* --- Measurement --- */
+
+static double min_ns = 50e6;
+static volatile uint64_t sink; // keeps the compiler from removing the measured work
+
+static double now_ns() {
+    timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+/**
+ * Type: Case
+ * A measured case : runs 'count' operations on vectors of elements of 'elemSize' bytes, and returns the number of
+ * operations it ran.
+ */
+typedef long (*Case)(int elemSize, int count);
+
+/**
+ * Type: Prepare
+ * Fills 'prepared' with 'count' elements of 'elemSize' bytes before every run of a case, outside of the measure.
+ */
+typedef void (*Prepare)(int elemSize, int count);
+
+static vector prepared; // vector of the cases which have a Prepare, disposed of after every run
+
+static void measure(const char *name, Case run, int elemSize, int count, Prepare prepare) {
+    long ops = 0;
+    uint64_t allocs = 0;
+    double elapsed = 0;
+    do {
+        if (prepare != NULL)
+            prepare(elemSize, count);
+        uint64_t allocs_before = allocations;
+        double start = now_ns();
+        ops += run(elemSize, count);
+        elapsed += now_ns() - start;
+        allocs += allocations - allocs_before;
+        if (prepare != NULL)
+            VectorDispose(&prepared);
+    } while (elapsed < min_ns);
+
+    printf("%-22s %6d %7d %12.2f %12.4f\n", name, elemSize, count, elapsed / ops, (double) allocs / ops);
+}
+
+/* --- Cases --- */
+
+static char element[256]; // element appended by the cases ; its first int is the sort key
+
+static void fill(vector *v, int elemSize, int count, int initialAllocation) {
+    VectorNew(v, elemSize, NULL, initialAllocation);
+    for (int i = 0 ; i < count ; i++) {
+        memcpy(element, &i, sizeof(int));
+        VectorAppend(v, element);
+    }
+}
+
+static long append(int elemSize, int count) {
+    vector v;
+    fill(&v, elemSize, count, 0);
+    VectorDispose(&v);
+    return count;
+}
+
+static long append_reserved(int elemSize, int count) {
+    vector v;
+    fill(&v, elemSize, count, count);
+    VectorDispose(&v);
+    return count;
+}
+
+static long append_arena(int elemSize, int count) {
+    static char storage[1 << 20];
+    VectorArena arena;
+    VectorArenaInit(&arena, storage, sizeof(storage));
+    VectorAllocator allocator = VectorArenaAllocator(&arena);
+
+    vector v;
+    VectorNewWith(&v, elemSize, NULL, 0, &allocator, 0);
+    for (int i = 0 ; i < count ; i++)
+        VectorAppend(&v, element);
+    VectorArenaReset(&arena);
+    return count;
+}
+
+static long append_inline(int elemSize, int count) {
+    InlineVector v;
+    VectorNewWith(&v.v, elemSize, NULL, 0, NULL, VECTOR_INLINE);
+    for (int i = 0 ; i < count ; i++)
+        VectorAppend(&v.v, element);
+    VectorDispose(&v.v);
+    return count;
+}
+
+static long insert_front(int elemSize, int count) {
+    vector v;
+    VectorNew(&v, elemSize, NULL, 0);
+    for (int i = 0 ; i < count ; i++)
+        VectorInsert(&v, element, 0);
+    VectorDispose(&v);
+    return count;
+}
+
+static void prepare_keys(int elemSize, int count) {
+    fill(&prepared, elemSize, count, count);
+}
+
+static void prepare_random_keys(int elemSize, int count) {
+    VectorNew(&prepared, elemSize, NULL, count);
+    srandom(count);
+    for (int i = 0 ; i < count ; i++) {
+        int key = random();
+        memcpy(element, &key, sizeof(int));
+        VectorAppend(&prepared, element);
+    }
+}
+
+static long delete_front(int elemSize, int count) {
+    for (int i = 0 ; i < count ; i++)
+        VectorDelete(&prepared, 0);
+    return count;
+}
+
+static long delete_back(int elemSize, int count) {
+    for (int i = count - 1 ; i >= 0 ; i--)
+        VectorDelete(&prepared, i);
+    return count;
+}
+
+static bool odd_key(void *elemAddr, void *auxData) {
+    int key;
+    memcpy(&key, elemAddr, sizeof(int));
+    return key & 1;
+}
+
+// Culling : removal of every other element, one at a time and in a single pass
+static long cull_delete(int elemSize, int count) {
+    for (int i = 0 ; i < VectorLength(&prepared) ; i++)
+        if (odd_key(VectorNth(&prepared, i), NULL))
+            VectorDelete(&prepared, i--);
+    return count;
+}
+
+static long cull_remove_if(int elemSize, int count) {
+    VectorRemoveIf(&prepared, odd_key, NULL);
+    return count;
+}
+
+static long swap_remove_front(int elemSize, int count) {
+    for (int i = 0 ; i < count ; i++)
+        VectorSwapRemove(&prepared, 0);
+    return count;
+}
+
+static int compare_keys(const void *a, const void *b) {
+    int x, y;
+    memcpy(&x, a, sizeof(int));
+    memcpy(&y, b, sizeof(int));
+    return (x > y) - (x < y);
+}
+
+static long sort(int elemSize, int count) {
+    VectorSort(&prepared, compare_keys);
+    return count;
+}
+
+static void add_key(void *elemAddr, void *auxData) {
+    int key;
+    memcpy(&key, elemAddr, sizeof(int));
+    *(long *) auxData += key;
+}
+
+static long map(int elemSize, int count) {
+    static vector v;
+    static int filledSize = 0, filledCount = 0;
+    if (filledSize != elemSize || filledCount != count) {
+        if (filledSize != 0)
+            VectorDispose(&v);
+        fill(&v, elemSize, count, count);
+        filledSize = elemSize;
+        filledCount = count;
+    }
+    long sum = 0;
+    VectorMap(&v, add_key, &sum);
+    sink += sum;
+    return count;
+}
+
+/* --- Search cases --- */
+
+static vector searched; // vector of 0, 2, 4, ... searched by the cases
+static int searchedCount = 0;
+static unsigned searchedKey = 0;
+
+static void fill_searched(int count) {
+    if (searchedCount == count)
+        return;
+    if (searchedCount != 0)
+        VectorDispose(&searched);
+    VectorNew(&searched, sizeof(int), NULL, count);
+    for (int i = 0 ; i < count ; i++) {
+        int key = 2 * i;
+        VectorAppend(&searched, &key);
+    }
+    searchedCount = count;
+}
+
+static int next_key(int count) {
+    searchedKey = searchedKey * 1103515245 + 12345;
+    return 2 * (int) ((searchedKey >> 8) % count);
+}
+
+static int compare_ints(const void *a, const void *b) {
+    return (*(const int *) a > *(const int *) b) - (*(const int *) a < *(const int *) b);
+}
+
+static long search_linear(int elemSize, int count) {
+    fill_searched(count);
+    for (int i = 0 ; i < 64 ; i++) {
+        int key = next_key(count);
+        sink += VectorSearch(&searched, &key, compare_ints, 0, false);
+    }
+    return 64;
+}
+
+static long search_lfind(int elemSize, int count) {
+    fill_searched(count);
+    for (int i = 0 ; i < 64 ; i++) {
+        int key = next_key(count);
+        size_t n = count;
+        sink += (uintptr_t) lfind(&key, searched.elems, &n, sizeof(int), compare_ints);
+    }
+    return 64;
+}
+
+static long search_find(int elemSize, int count) {
+    fill_searched(count);
+    for (int i = 0 ; i < 64 ; i++)
+        sink += VectorFind(&searched, next_key(count), 0);
+    return 64;
+}
+
+static long search_binary(int elemSize, int count) {
+    fill_searched(count);
+    for (int i = 0 ; i < 64 ; i++) {
+        int key = next_key(count);
+        sink += VectorSearch(&searched, &key, compare_ints, 0, true);
+    }
+    return 64;
+}
+
+static long search_bsearch(int elemSize, int count) {
+    fill_searched(count);
+    for (int i = 0 ; i < 64 ; i++) {
+        int key = next_key(count);
+        sink += (uintptr_t) bsearch(&key, searched.elems, count, sizeof(int), compare_ints);
+    }
+    return 64;
+}
+
+static long search_typed_binary(int elemSize, int count) {
+    fill_searched(count);
+    for (int i = 0 ; i < 64 ; i++) {
+        int key = next_key(count);
+        sink += VectorSearchTyped(&searched, key, [](const int &a, const int &b) { return (a > b) - (a < b); },
+                                  0, true);
+    }
+    return 64;
+}
+
+int main(int argc, char **argv) {
+    int opt;
+    while ((opt = getopt(argc, argv, "m:")) != -1) {
+        if (opt == 'm') {
+            min_ns = atof(optarg) * 1e6;
+        } else {
+            fprintf(stderr, "usage: %s [-m min_ms]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    static const int sizes[] = { 4, 16, 64 };
+    static const int counts[] = { 8, 256, 4096 };
+    static const struct { const char *name; Case run; Prepare prepare; } cases[] = {
+        { "append", append, NULL },
+        { "append_reserved", append_reserved, NULL },
+        { "append_arena", append_arena, NULL },
+        { "append_inline", append_inline, NULL },
+        { "insert_front", insert_front, NULL },
+        { "delete_front", delete_front, prepare_keys },
+        { "delete_back", delete_back, prepare_keys },
+        { "swap_remove_front", swap_remove_front, prepare_keys },
+        { "cull_delete", cull_delete, prepare_keys },
+        { "cull_remove_if", cull_remove_if, prepare_keys },
+        { "sort", sort, prepare_random_keys },
+        { "map", map, NULL },
+    };
+
+    printf("%-22s %6s %7s %12s %12s\n", "case", "elem", "count", "ns/op", "allocs/op");
+    for (unsigned c = 0 ; c < sizeof(cases) / sizeof(cases[0]) ; c++)
+        for (unsigned s = 0 ; s < sizeof(sizes) / sizeof(sizes[0]) ; s++)
+            for (unsigned n = 0 ; n < sizeof(counts) / sizeof(counts[0]) ; n++)
+                measure(cases[c].name, cases[c].run, sizes[s], counts[n], cases[c].prepare);
+
+    static const struct { const char *name; Case run; } searches[] = {
+        { "search_linear", search_linear },
+        { "search_lfind", search_lfind },
+        { "search_find", search_find },
+        { "search_binary", search_binary },
+        { "search_bsearch", search_bsearch },
+        { "search_typed_binary", search_typed_binary },
+    };
+    for (unsigned c = 0 ; c < sizeof(searches) / sizeof(searches[0]) ; c++)
+        for (unsigned n = 0 ; n < sizeof(counts) / sizeof(counts[0]) ; n++)
+            measure(searches[c].name, searches[c].run, sizeof(int), counts[n], NULL);
+    return 0;
+}
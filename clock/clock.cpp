@@ -0,0 +1,46 @@
+#include "clock.hpp"
+#include <avr/interrupt.h>
+#include <util/atomic.h>
+
+static volatile uint32_t clockMillis = 0;
+
+void Clock_Init(void)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        clockMillis = 0;
+        TCNT0 = 0;
+        OCR0A = CLOCK_STEPS_PER_MS - 1;
+        TCCR0A = (1 << WGM01); // CTC mode
+        TCCR0B = (1 << CS01) | (1 << CS00); // prescaler 64
+        TIFR0 = (1 << OCF0A);
+        TIMSK0 |= (1 << OCIE0A);
+    }
+}
+
+uint32_t Clock_Millis(void)
+{
+    uint32_t ms;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        ms = clockMillis;
+    }
+    return ms;
+}
+
+uint32_t Clock_Micros(void)
+{
+    uint32_t ms;
+    uint8_t steps;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        ms = clockMillis;
+        steps = TCNT0;
+        // The timer wrapped around, but the interrupt did not run yet (interrupts disabled)
+        if ((TIFR0 & (1 << OCF0A)) && steps < CLOCK_STEPS_PER_MS / 2)
+            ms++;
+    }
+    return ms * 1000 + steps * CLOCK_US_PER_STEP;
+}
+
+ISR(TIMER0_COMPA_vect)
+{
+    clockMillis++;
+}
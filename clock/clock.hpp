@@ -0,0 +1,40 @@
+/**
+ * File: clock.hpp
+ * ---------------
+ * System clock of the firmware, counting the time since Clock_Init with Timer0.
+ *
+ * Timer0 runs in CTC mode with a prescaler of 64 : it counts in steps of 4 us, and its compare interrupt adds one to
+ * the millisecond counter every 250 steps. Reading the counter and the timer together gives the time to 4 us, from
+ * the main program as well as from the interrupts.
+ */
+
+#ifndef _clock_
+#define _clock_
+
+#include <avr/io.h>
+#include <stdint.h>
+
+// Timer0 steps per millisecond, and microseconds per step
+#define CLOCK_STEPS_PER_MS (F_CPU / 64 / 1000)
+#define CLOCK_US_PER_STEP (1000 / CLOCK_STEPS_PER_MS)
+
+/**
+ * Function: Clock_Init
+ * Starts the clock from 0. Timer0 is reserved to the clock.
+ */
+void Clock_Init(void);
+
+/**
+ * Function: Clock_Millis
+ * @return uint32_t - milliseconds since Clock_Init ; wraps around after 49 days.
+ */
+uint32_t Clock_Millis(void);
+
+/**
+ * Function: Clock_Micros
+ * Can be called with the interrupts disabled, including from an interrupt.
+ * @return uint32_t - microseconds since Clock_Init, to CLOCK_US_PER_STEP ; wraps around after 71 minutes.
+ */
+uint32_t Clock_Micros(void);
+
+#endif
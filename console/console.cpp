@@ -0,0 +1,123 @@
+#include "console.hpp"
+#include "../uartLib/uart.hpp"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const ConsoleVar *consoleVars = NULL;
+static uint8_t consoleNbVars = 0;
+static const ConsoleCommand *consoleCommands = NULL;
+static uint8_t consoleNbCommands = 0;
+
+void Console_Init(const ConsoleVar *vars, uint8_t nb_vars, const ConsoleCommand *commands, uint8_t nb_commands)
+{
+    consoleVars = vars;
+    consoleNbVars = nb_vars;
+    consoleCommands = commands;
+    consoleNbCommands = nb_commands;
+}
+
+void Console_Print(const char *s)
+{
+    USART_Transmit_String((char *) s);
+}
+
+static const ConsoleVar *FindVar(const char *name)
+{
+    for (uint8_t i = 0; i < consoleNbVars; i++) {
+        if (strcmp(consoleVars[i].name, name) == 0)
+            return &consoleVars[i];
+    }
+    Console_Print("unknown variable");
+    return NULL;
+}
+
+/**
+ * Reads or writes a variable as an unsigned integer of its size. The AVR and the hosts are little-endian, so the
+ * low-order bytes of the integer are the variable's.
+ */
+static uint32_t ReadVar(const ConsoleVar *var)
+{
+    uint32_t value = 0;
+    memcpy(&value, var->value, var->size);
+    return value;
+}
+
+static void WriteVar(const ConsoleVar *var, uint32_t value)
+{
+    memcpy(var->value, &value, var->size);
+}
+
+static void PrintVar(const ConsoleVar *var)
+{
+    char line[USART_LINE_SIZE + 12];
+    sprintf(line, "%s = %lu", var->name, (unsigned long) ReadVar(var));
+    Console_Print(line);
+}
+
+static void Run(uint8_t argc, char **argv)
+{
+    if (strcmp(argv[0], "get") == 0 && argc == 2) {
+        const ConsoleVar *var = FindVar(argv[1]);
+        if (var != NULL)
+            PrintVar(var);
+        return;
+    }
+
+    if (strcmp(argv[0], "set") == 0 && argc == 3) {
+        const ConsoleVar *var = FindVar(argv[1]);
+        if (var == NULL)
+            return;
+        char *end;
+        unsigned long value = strtoul(argv[2], &end, 0);
+        if (*end != '\0' || (var->size < 4 && value >> (8 * var->size) != 0) || (var->boolean && value > 1)) {
+            Console_Print("invalid value");
+            return;
+        }
+        WriteVar(var, value);
+        if (var->changed != NULL)
+            var->changed();
+        PrintVar(var);
+        return;
+    }
+
+    if (strcmp(argv[0], "help") == 0) {
+        Console_Print("get <var> ; set <var> <value>");
+        for (uint8_t i = 0; i < consoleNbVars; i++)
+            PrintVar(&consoleVars[i]);
+        for (uint8_t i = 0; i < consoleNbCommands; i++) {
+            char line[USART_LINE_SIZE + 32];
+            snprintf(line, sizeof(line), "%s %s", consoleCommands[i].name, consoleCommands[i].help);
+            Console_Print(line);
+        }
+        return;
+    }
+
+    for (uint8_t i = 0; i < consoleNbCommands; i++) {
+        if (strcmp(consoleCommands[i].name, argv[0]) == 0) {
+            consoleCommands[i].run(argc, argv);
+            return;
+        }
+    }
+    Console_Print("unknown command, try 'help'");
+}
+
+bool Console_Poll(void)
+{
+    char line[USART_LINE_SIZE];
+    if (!USART_Read_Line(line, sizeof(line)))
+        return false;
+
+    // Split the line in words, in place
+    char *argv[CONSOLE_MAX_ARGS + 1];
+    uint8_t argc = 0;
+    char *word = strtok(line, " ");
+    while (word != NULL && argc <= CONSOLE_MAX_ARGS) {
+        argv[argc++] = word;
+        word = strtok(NULL, " ");
+    }
+
+    if (argc > 0)
+        Run(argc, argv);
+    return true;
+}
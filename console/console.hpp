@@ -0,0 +1,79 @@
+/**
+ * File: console.hpp
+ * -----------------
+ * Command console over USART, to tune and inspect the game while it runs.
+ *
+ * The lines are received by the USART RX interrupt (see USART_Read_Line), and Console_Poll runs the last complete one,
+ * if any : it never waits, so it can be called from the game loop and from the waiting loops. A line is a command name
+ * followed by its arguments, separated by spaces. Two commands are built in :
+ *   get <name>          - sends the value of a variable
+ *   set <name> <value>  - changes the value of a variable
+ * The other commands, and the variables, are given by the firmware to Console_Init. 'help' lists all of them.
+ */
+
+#ifndef _console_
+#define _console_
+
+#include <stdint.h>
+
+#define CONSOLE_MAX_ARGS 3 // arguments of a command, at most
+
+/**
+ * Struct: ConsoleVar
+ * A variable of the firmware, readable and writable from the console.
+ * @public name - name of the variable in the console
+ * @public value - address of the variable : an unsigned integer (or a bool) of 'size' bytes
+ * @public size - size of the variable, in bytes : 1, 2 or 4
+ * @public boolean - whether the variable is a bool, which can only be set to 0 or 1
+ * @public changed - called after the variable is set from the console, or NULL
+ */
+struct ConsoleVar {
+    const char *name;
+    void *value;
+    uint8_t size;
+    bool boolean;
+    void (*changed)(void);
+};
+
+/**
+ * Struct: ConsoleCommand
+ * A command of the firmware, run from the console.
+ * @public name - name of the command in the console
+ * @public run - runs the command, given the number of arguments and the arguments
+ * @public help - arguments and description of the command, listed by 'help'
+ */
+struct ConsoleCommand {
+    const char *name;
+    void (*run)(uint8_t argc, char **argv);
+    const char *help;
+};
+
+// Declares a ConsoleVar of an unsigned integer variable, or of a bool variable, with its name in the console
+#define CONSOLE_VAR(name, variable, changed) { name, &(variable), sizeof(variable), false, changed }
+#define CONSOLE_BOOL(name, variable, changed) { name, &(variable), sizeof(variable), true, changed }
+
+/**
+ * Function: Console_Init
+ * Sets the variables and the commands of the console. The tables must outlive the console.
+ * @param vars - variables readable and writable from the console
+ * @param nb_vars - number of variables
+ * @param commands - commands of the firmware
+ * @param nb_commands - number of commands
+ */
+void Console_Init(const ConsoleVar *vars, uint8_t nb_vars, const ConsoleCommand *commands, uint8_t nb_commands);
+
+/**
+ * Function: Console_Poll
+ * Runs the last line received via USART, if a complete one was received. Does not wait.
+ * @return bool - whether a line was run, or not
+ */
+bool Console_Poll(void);
+
+/**
+ * Function: Console_Print
+ * Sends a line of output of the console via USART.
+ * @param s - line to send, without its end of line
+ */
+void Console_Print(const char *s);
+
+#endif
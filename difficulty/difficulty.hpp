@@ -0,0 +1,78 @@
+/**
+ * File: difficulty.hpp
+ * --------------------
+ * Compile-time table of the difficulty levels of the game.
+ *
+ * The potentiometer's 10-bit ADC value is split in equally wide bands, one per difficulty level. Every parameter of a
+ * level lives in the DIFFICULTIES table below, so changing the difficulties only means changing data : the lookup is a
+ * single shift and index, without any branch.
+ *
+ * The table has no delay between two game steps on purpose : the delay is the ADC value itself, in ms, so the
+ * potentiometer also tunes the speed within a level.
+ */
+
+#ifndef _difficulty_
+#define _difficulty_
+
+#include <stdint.h>
+
+/**
+ * Struct: Difficulty
+ * Describes a difficulty level and the band of ADC values selecting it.
+ * @public adc_lo - lowest ADC value of the band (inclusive).
+ * @public adc_hi - highest ADC value of the band (inclusive).
+ * @public level - difficulty level shown to the player, which is also the score multiplier.
+ * @public spawn_threshold - a random byte has to be greater than or equal to this threshold for a new obstacle to be
+ *                           generated : the chance to generate an obstacle is (256 - spawn_threshold) / 256.
+ * @public led_mask - diodes to turn on while the level is selected : bit 0 is LED4, ..., bit 3 is LED1.
+ */
+struct Difficulty {
+    uint16_t adc_lo;
+    uint16_t adc_hi;
+    uint8_t level;
+    uint8_t spawn_threshold;
+    uint8_t led_mask;
+};
+
+// Width of the ADC value, and of a band of ADC values (as a power of 2)
+#define DIFFICULTY_ADC_BITS 10
+#define DIFFICULTY_BAND_SHIFT 8
+#define DIFFICULTY_COUNT (1 << (DIFFICULTY_ADC_BITS - DIFFICULTY_BAND_SHIFT))
+
+constexpr Difficulty DIFFICULTIES[DIFFICULTY_COUNT] = {
+    // ADC from  to   level  spawn  LEDs
+    {     0,   255,    4,     26,   0x0F },
+    {   256,   511,    3,     51,   0x07 },
+    {   512,   767,    2,    128,   0x03 },
+    {   768,  1023,    1,    205,   0x01 },
+};
+
+/**
+ * Function: difficulty_bands_contiguous(int)
+ * Checks that the bands of the table, starting from the i-th one, follow each other without any gap nor overlap, and
+ * are as wide as the lookup of difficulty_for assumes.
+ * @param i - index of the first band to check
+ * @return bool - whether the bands are contiguous, or not
+ */
+constexpr bool difficulty_bands_contiguous(int i) {
+    return i == DIFFICULTY_COUNT
+        || (DIFFICULTIES[i].adc_lo == (i << DIFFICULTY_BAND_SHIFT)
+            && DIFFICULTIES[i].adc_hi == ((i + 1) << DIFFICULTY_BAND_SHIFT) - 1
+            && difficulty_bands_contiguous(i + 1));
+}
+
+static_assert(difficulty_bands_contiguous(0), "Difficulty bands must be contiguous and as wide as a lookup band");
+static_assert(DIFFICULTIES[DIFFICULTY_COUNT - 1].adc_hi == (1 << DIFFICULTY_ADC_BITS) - 1,
+              "Difficulty bands must cover every ADC value");
+
+/**
+ * Function: difficulty_for(uint16_t)
+ * Looks up the difficulty level selected by a value of the potentiometer.
+ * @param adc_value - value read from the ADC
+ * @return Difficulty - descriptor of the selected difficulty level
+ */
+constexpr const Difficulty &difficulty_for(uint16_t adc_value) {
+    return DIFFICULTIES[(adc_value >> DIFFICULTY_BAND_SHIFT) & (DIFFICULTY_COUNT - 1)];
+}
+
+#endif
@@ -6,6 +6,60 @@
 
 #include "HD44780.hpp"
 
+#ifdef LCD_ASYNC
+#include "../spsc/spsc.hpp"
+#include <avr/interrupt.h>
+#include <avr/sleep.h>
+#include <util/atomic.h>
+
+// Timer1 in CTC mode, prescaler 8 : waits after each byte, in timer cycles
+#define LCD_TICKS_START		1						// before the first byte, when the queue was idle
+#define LCD_TICKS			(F_CPU / 8 / 20000)		// 50 us, as _LCD_Write
+#define LCD_TICKS_SLOW		(F_CPU / 8 / 500)		// 2 ms, as LCD_Clear and LCD_Home
+
+// Queue entries : the byte, and how to send it
+#define LCD_QUEUE_DATA		0x100					// data byte (RS = 1), else a command
+#define LCD_QUEUE_SLOW		0x200					// the controller needs 2 ms to execute it
+
+// Filled by the main program, drained by the timer interrupt
+static Spsc<unsigned int, LCD_QUEUE_SIZE> lcdQueue;
+static volatile bool lcdMarkPending = false;		// the mark hook is called once lcdMarkAt entries are sent
+static volatile unsigned char lcdMarkAt;			// entries queued when LCD_Mark was called (modulo 256)
+#endif
+
+#ifdef LCD_I2C
+#include <avr/interrupt.h>
+#include <avr/sleep.h>
+#include <util/atomic.h>
+
+// TWI bit rate register, with a prescaler of 1
+#define LCD_I2C_TWBR		((F_CPU / LCD_I2C_SCL - 16) / 2)
+
+// Expander writes lasting as long as a clear or a home (2 ms) : 9 clock cycles per write
+#define LCD_I2C_SLOW_WRITES	((2000UL * (LCD_I2C_SCL / 1000) / 1000 + 8) / 9)
+
+// Status codes of the TWI master transmitter
+#define LCD_TW_START		0x08
+#define LCD_TW_REP_START	0x10
+#define LCD_TW_SLA_ACK		0x18
+#define LCD_TW_DATA_ACK		0x28
+
+static_assert(LCD_I2C_TWBR <= 255, "LCD_I2C_SCL is too slow for the TWI prescaler of 1");
+static_assert(LCD_I2C_SCL <= 400000, "Two expander writes must last longer than an instruction of the HD44780");
+
+static volatile unsigned char lcdTwiBuffer[LCD_I2C_BUFFER_SIZE];
+static volatile unsigned char lcdTwiHead = 0;		// next write to send
+static volatile unsigned char lcdTwiLength = 0;		// writes waiting
+static volatile bool lcdTwiBusy = false;			// a transaction is in progress
+static volatile bool lcdTwiInFlight = false;		// a write is being sent, and not acknowledged yet
+static volatile unsigned char lcdTwiMarkLeft = 0;	// writes to acknowledge before calling the mark hook, 0 if none
+static unsigned char lcdExpander = LCD_I2C_BACKLIGHT; // last write queued
+static unsigned char lcdRs = 0;						// RS of the byte being written
+#endif
+
+static LCD_QueueStats lcdStats;
+static void (*lcdMarkHook)(void) = 0;
+
 //-------------------------------------------------------------------------------------------------
 // A function that exposes a half-byte to a data bus
 //-------------------------------------------------------------------------------------------------
@@ -30,9 +84,9 @@ else
 }
 
 //-------------------------------------------------------------------------------------------------
-// Write byte function to the display (no distinction between instructions / data)
+// Function clocking a byte out to the display, without waiting for its execution
 //-------------------------------------------------------------------------------------------------
-void _LCD_Write(unsigned char dataToWrite)
+void _LCD_Send(unsigned char dataToWrite)
 {
 LCD_E_PORT |= LCD_E;
 _LCD_OutNibble(dataToWrite >> 4);
@@ -40,16 +94,211 @@ LCD_E_PORT &= ~LCD_E;
 LCD_E_PORT |= LCD_E;
 _LCD_OutNibble(dataToWrite);
 LCD_E_PORT &= ~LCD_E;
+}
+
+//-------------------------------------------------------------------------------------------------
+// Write byte function to the display (no distinction between instructions / data)
+//-------------------------------------------------------------------------------------------------
+void _LCD_Write(unsigned char dataToWrite)
+{
+_LCD_Send(dataToWrite);
 _delay_us(50);
 }
 
+#if defined(LCD_ASYNC) || defined(LCD_I2C)
+//-------------------------------------------------------------------------------------------------
+// Function putting the CPU to sleep until the condition is false. Each interrupt wakes it up.
+// The interrupts are enabled again on return.
+//-------------------------------------------------------------------------------------------------
+static void _LCD_SleepWhile(bool (*condition)(void))
+{
+	set_sleep_mode(SLEEP_MODE_IDLE);
+	cli();
+	while (condition()) {
+		sleep_enable();
+		sei();
+		sleep_cpu(); // executed before any interrupt enabled by sei : the wake-up cannot be missed
+		sleep_disable();
+		cli();
+	}
+	sei();
+}
+#endif
+
+#ifdef LCD_I2C
+static bool _LCD_TwiFull(void)
+{
+	return lcdTwiLength == LCD_I2C_BUFFER_SIZE;
+}
+
+static bool _LCD_TwiBusy(void)
+{
+	return lcdTwiBusy;
+}
+
+//-------------------------------------------------------------------------------------------------
+// Function queuing a write of the expander, and starting a transaction if the bus was idle.
+// Sleeps until there is room in the buffer if it is full.
+//-------------------------------------------------------------------------------------------------
+void _LCD_Expand(unsigned char value)
+{
+	if (_LCD_TwiFull()) {
+		lcdStats.stalls++;
+		_LCD_SleepWhile(_LCD_TwiFull);
+	}
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		lcdTwiBuffer[(lcdTwiHead + lcdTwiLength) & (LCD_I2C_BUFFER_SIZE - 1)] = value;
+		lcdTwiLength++;
+		if (lcdTwiLength > lcdStats.maxDepth)
+			lcdStats.maxDepth = lcdTwiLength;
+
+		// While a transaction is in progress, the write joins it
+		if (!lcdTwiBusy) {
+			lcdTwiBusy = true;
+			lcdStats.transactions++;
+			while (TWCR & (1 << TWSTO))
+				; // the stop condition of the previous transaction
+			TWCR = (1 << TWINT) | (1 << TWSTA) | (1 << TWEN) | (1 << TWIE);
+		}
+	}
+	lcdExpander = value;
+}
+
+//-------------------------------------------------------------------------------------------------
+// Function clocking a half-byte out to the display through the expander : E high, then E low.
+// RS is set one write before E rises when it changes.
+//-------------------------------------------------------------------------------------------------
+void _LCD_StrobeNibble(unsigned char nibbleToWrite)
+{
+	unsigned char value = ((nibbleToWrite & 0x0F) << LCD_I2C_DATA_SHIFT) | lcdRs | LCD_I2C_BACKLIGHT;
+	if ((value ^ lcdExpander) & LCD_I2C_RS)
+		_LCD_Expand(value);
+	_LCD_Expand(value | LCD_I2C_E);
+	_LCD_Expand(value);
+}
+
+//-------------------------------------------------------------------------------------------------
+// TWI interrupt sending the buffer in a single transaction : the address of the expander, then
+// one write per acknowledge, and the stop condition once the buffer is empty.
+//-------------------------------------------------------------------------------------------------
+ISR(TWI_vect)
+{
+	switch (TWSR & 0xF8) {
+		case LCD_TW_START:
+		case LCD_TW_REP_START:
+			TWDR = LCD_I2C_ADDRESS << 1; // write
+			TWCR = (1 << TWINT) | (1 << TWEN) | (1 << TWIE);
+			return;
+
+		case LCD_TW_DATA_ACK:
+			lcdTwiInFlight = false;
+			if (lcdTwiMarkLeft > 0 && --lcdTwiMarkLeft == 0 && lcdMarkHook)
+				lcdMarkHook();
+			// fall through
+		case LCD_TW_SLA_ACK:
+			if (lcdTwiLength > 0) {
+				TWDR = lcdTwiBuffer[lcdTwiHead];
+				lcdTwiHead = (lcdTwiHead + 1) & (LCD_I2C_BUFFER_SIZE - 1);
+				lcdTwiLength--;
+				lcdTwiInFlight = true;
+				TWCR = (1 << TWINT) | (1 << TWEN) | (1 << TWIE);
+				return;
+			}
+			break;
+
+		default:
+			// No acknowledge, or the bus was lost : the writes waiting are dropped
+			lcdStats.errors++;
+			lcdTwiHead = (lcdTwiHead + lcdTwiLength) & (LCD_I2C_BUFFER_SIZE - 1);
+			lcdTwiLength = 0;
+			lcdTwiInFlight = false;
+			lcdTwiMarkLeft = 0;
+			break;
+	}
+
+	TWCR = (1 << TWINT) | (1 << TWSTO) | (1 << TWEN);
+	lcdTwiBusy = false;
+}
+#endif
+
+#ifdef LCD_ASYNC
+static bool _LCD_QueueFull(void)
+{
+	return lcdQueue.full();
+}
+
+//-------------------------------------------------------------------------------------------------
+// Function queuing a byte, and starting the timer interrupt if the queue was idle.
+// Sleeps until there is room in the queue if it is full.
+//-------------------------------------------------------------------------------------------------
+void _LCD_Enqueue(unsigned int entry)
+{
+	if (_LCD_QueueFull()) {
+		lcdStats.stalls++;
+		_LCD_SleepWhile(_LCD_QueueFull);
+	}
+
+	// Only the main program fills the queue : there is room, whatever the interrupt does meanwhile
+	lcdQueue.push(entry);
+	lcdStats.queued++;
+	if (lcdQueue.size() > lcdStats.maxDepth)
+		lcdStats.maxDepth = lcdQueue.size();
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		// While the interrupt is enabled, the controller may still be busy : the byte is sent on its next cycle
+		if (!(TIMSK1 & (1 << OCIE1A))) {
+			TCNT1 = 0;
+			OCR1A = LCD_TICKS_START;
+			TIFR1 = (1 << OCF1A);
+			TIMSK1 |= (1 << OCIE1A);
+		}
+	}
+}
+
+//-------------------------------------------------------------------------------------------------
+// Timer interrupt sending one byte of the queue per cycle, the cycle lasting as long as the
+// controller needs to execute the byte. Stops itself one cycle after the queue is empty.
+//-------------------------------------------------------------------------------------------------
+ISR(TIMER1_COMPA_vect)
+{
+	unsigned int entry;
+	if (!lcdQueue.pop(&entry)) {
+		TIMSK1 &= ~(1 << OCIE1A);
+		return;
+	}
+
+	if (entry & LCD_QUEUE_DATA)
+		LCD_RS_PORT |= LCD_RS;
+	else
+		LCD_RS_PORT &= ~LCD_RS;
+	_LCD_Send(entry);
+	OCR1A = (entry & LCD_QUEUE_SLOW) ? LCD_TICKS_SLOW : LCD_TICKS;
+	if (lcdMarkPending && lcdQueue.popped() == lcdMarkAt) {
+		lcdMarkPending = false;
+		if (lcdMarkHook)
+			lcdMarkHook();
+	}
+}
+#endif
+
 //-------------------------------------------------------------------------------------------------
 // Function to write the command to the display
 //-------------------------------------------------------------------------------------------------
 void LCD_WriteCommand(unsigned char commandToWrite)
 {
+#if defined(LCD_ASYNC)
+	_LCD_Enqueue(commandToWrite);
+#elif defined(LCD_I2C)
+	lcdStats.queued++;
+	lcdRs = 0;
+	_LCD_StrobeNibble(commandToWrite >> 4);
+	_LCD_StrobeNibble(commandToWrite);
+#else
+	lcdStats.queued++;
 	LCD_RS_PORT &= ~LCD_RS;
 	_LCD_Write(commandToWrite);
+#endif
 }
 
 //-------------------------------------------------------------------------------------------------
@@ -57,8 +306,18 @@ void LCD_WriteCommand(unsigned char commandToWrite)
 //-------------------------------------------------------------------------------------------------
 void LCD_WriteData(unsigned char dataToWrite)
 {
+#if defined(LCD_ASYNC)
+	_LCD_Enqueue(LCD_QUEUE_DATA | dataToWrite);
+#elif defined(LCD_I2C)
+	lcdStats.queued++;
+	lcdRs = LCD_I2C_RS;
+	_LCD_StrobeNibble(dataToWrite >> 4);
+	_LCD_StrobeNibble(dataToWrite);
+#else
+	lcdStats.queued++;
 	LCD_RS_PORT |= LCD_RS;
 	_LCD_Write(dataToWrite);
+#endif
 }
 
 //-------------------------------------------------------------------------------------------------
@@ -83,8 +342,16 @@ void LCD_GoTo(unsigned char x, unsigned char y)
 //-------------------------------------------------------------------------------------------------
 void LCD_Clear(void)
 {
+#if defined(LCD_ASYNC)
+	_LCD_Enqueue(LCD_QUEUE_SLOW | HD44780_CLEAR);
+#elif defined(LCD_I2C)
+	LCD_WriteCommand(HD44780_CLEAR);
+	for (unsigned char i = 0; i < LCD_I2C_SLOW_WRITES; i++)
+		_LCD_Expand(lcdExpander); // the same outputs, while the controller executes it
+#else
 	LCD_WriteCommand(HD44780_CLEAR);
 	_delay_ms(2);
+#endif
 }
 
 //-------------------------------------------------------------------------------------------------
@@ -92,23 +359,73 @@ void LCD_Clear(void)
 //-------------------------------------------------------------------------------------------------
 void LCD_Home(void)
 {
+#if defined(LCD_ASYNC)
+	_LCD_Enqueue(LCD_QUEUE_SLOW | HD44780_HOME);
+#elif defined(LCD_I2C)
+	LCD_WriteCommand(HD44780_HOME);
+	for (unsigned char i = 0; i < LCD_I2C_SLOW_WRITES; i++)
+		_LCD_Expand(lcdExpander); // the same outputs, while the controller executes it
+#else
 	LCD_WriteCommand(HD44780_HOME);
 	_delay_ms(2);
+#endif
+}
+
+//-------------------------------------------------------------------------------------------------
+// Function to shift the display one character to the left, over the DDRAM of each line
+//-------------------------------------------------------------------------------------------------
+void LCD_ShiftLeft(void)
+{
+	LCD_WriteCommand(HD44780_DISPLAY_CURSOR_SHIFT | HD44780_SHIFT_DISPLAY | HD44780_SHIFT_LEFT);
 }
 
 //-------------------------------------------------------------------------------------------------
 // HD44780 controller initialization procedure
+// After a power-on, the supply voltage has to stabilize and the controller runs its internal reset
+// after the first 8-bit function set. When the display stayed powered through a reset of the
+// microcontroller (warm restart), the controller is already set up : the three 8-bit function sets
+// only bring it back to a known interface mode, whatever nibble it was waiting for, and the
+// slowest instruction one of them may complete (clear or home, 1.52 ms) is all there is to wait.
 //-------------------------------------------------------------------------------------------------
-void LCD_Initalize(void)
+static void _LCD_SyncDelay(bool powered)
+{
+	if (powered)
+		_delay_ms(2);
+	else
+		_delay_ms(5);
+}
+
+static void _LCD_Start(bool powered)
 {
 	unsigned char i;
+	LCD_Flush();			// the queue must not send anything during the reset sequence
+#ifdef LCD_ASYNC
+	TCCR1A = 0;
+	TCCR1B = (1 << WGM12) | (1 << CS11); // Timer1 in CTC mode, prescaler 8
+#endif
+#ifdef LCD_I2C
+	TWSR = 0; // prescaler 1
+	TWBR = LCD_I2C_TWBR;
+	TWCR = (1 << TWEN);
+	if (!powered)
+		_delay_ms(15); 		// waiting for the supply voltage to stabilize
+	lcdRs = 0;
+	for(i = 0; i < 3; i++){ // repeating the instruction block three times
+	  _LCD_StrobeNibble(0x03); // 8-bit mode
+	  LCD_Flush();
+	  _LCD_SyncDelay(powered);
+	}
+	_LCD_StrobeNibble(0x02); // 4-bit mode
+	LCD_Flush();
+#else
 	LCD_DB4_DIR |= LCD_DB4; // |
 	LCD_DB5_DIR |= LCD_DB5; // |
 	LCD_DB6_DIR |= LCD_DB6; // |> Configuration of the direction of the leads (for AVT1615 Arduino shield)
 	LCD_DB7_DIR |= LCD_DB7; // |
 	LCD_E_DIR 	|= LCD_E;   // |
 	LCD_RS_DIR 	|= LCD_RS;  // |
-	_delay_ms(15); 			// waiting for the supply voltage to stabilize
+	if (!powered)
+		_delay_ms(15); 		// waiting for the supply voltage to stabilize
 	LCD_RS_PORT &= ~LCD_RS; // resetting the RS line
 	LCD_E_PORT &= ~LCD_E;   // resetting the E line
 
@@ -116,18 +433,104 @@ void LCD_Initalize(void)
 	  LCD_E_PORT |= LCD_E;  // E = 1
 	  _LCD_OutNibble(0x03); // 8-bit mode
 	  LCD_E_PORT &= ~LCD_E; // E = 0
-	  _delay_ms(5); 		// wait 5ms
+	  _LCD_SyncDelay(powered);
 	}
 
 	LCD_E_PORT |= LCD_E;	// E = 1
 	_LCD_OutNibble(0x02); 	// 4-bit mode
 	LCD_E_PORT &= ~LCD_E; 	// E = 0
+#endif
 
 	_delay_ms(1); 			// wait 1ms
 	LCD_WriteCommand(HD44780_FUNCTION_SET | HD44780_FONT5x7 | HD44780_TWO_LINE | HD44780_4_BIT); // 4-bit interface, 2-lines, signes 5x7
 	LCD_WriteCommand(HD44780_DISPLAY_ONOFF | HD44780_DISPLAY_OFF); // switching off display
-	LCD_WriteCommand(HD44780_CLEAR); // cleaning the DDRAM memory
-	_delay_ms(2);
+	LCD_Clear(); // cleaning the DDRAM memory
 	LCD_WriteCommand(HD44780_ENTRY_MODE | HD44780_EM_SHIFT_CURSOR | HD44780_EM_INCREMENT);// the address incrementation and the cursor move
 	LCD_WriteCommand(HD44780_DISPLAY_ONOFF | HD44780_DISPLAY_ON | HD44780_CURSOR_OFF | HD44780_CURSOR_NOBLINK); // turn on LCD without cursor and blinking
 }
+
+void LCD_Initalize(void)
+{
+	_LCD_Start(false);
+}
+
+//-------------------------------------------------------------------------------------------------
+// Initialization after a reset of the microcontroller which kept the display powered
+//-------------------------------------------------------------------------------------------------
+void LCD_Restart(void)
+{
+	_LCD_Start(true);
+}
+
+//-------------------------------------------------------------------------------------------------
+// Function waiting until every queued byte has been executed by the controller.
+// The interrupts must be enabled ; they are enabled again on return.
+//-------------------------------------------------------------------------------------------------
+#ifdef LCD_ASYNC
+static bool _LCD_TimerRunning(void)
+{
+	return TIMSK1 & (1 << OCIE1A);
+}
+#endif
+
+void LCD_Flush(void)
+{
+#if defined(LCD_ASYNC)
+	_LCD_SleepWhile(_LCD_TimerRunning);
+#elif defined(LCD_I2C)
+	_LCD_SleepWhile(_LCD_TwiBusy);
+#endif
+}
+
+//-------------------------------------------------------------------------------------------------
+// Functions reading and resetting the statistics of the queue
+//-------------------------------------------------------------------------------------------------
+void LCD_GetQueueStats(LCD_QueueStats *stats)
+{
+	*stats = lcdStats;
+}
+
+void LCD_ResetQueueStats(void)
+{
+	lcdStats.queued = 0;
+	lcdStats.maxDepth = 0;
+	lcdStats.stalls = 0;
+	lcdStats.transactions = 0;
+	lcdStats.errors = 0;
+}
+
+//-------------------------------------------------------------------------------------------------
+// Functions marking the last byte written : the hook is called once it is sent to the display,
+// from the timer interrupt in asynchronous mode, or right away if it was already sent. With
+// LCD_I2C, it is called from the TWI interrupt, and a mark replaces the one still pending.
+//-------------------------------------------------------------------------------------------------
+void LCD_OnMark(void (*hook)(void))
+{
+	lcdMarkHook = hook;
+}
+
+void LCD_Mark(void)
+{
+#ifdef LCD_ASYNC
+	bool queued = false;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		if (!lcdQueue.empty()) {
+			lcdMarkAt = lcdQueue.pushed();
+			lcdMarkPending = true;
+			queued = true;
+		}
+	}
+	if (queued)
+		return;
+#elif defined(LCD_I2C)
+	bool queued = false;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		lcdTwiMarkLeft = lcdTwiLength + lcdTwiInFlight;
+		queued = lcdTwiMarkLeft > 0;
+	}
+	if (queued)
+		return;
+#endif
+	if (lcdMarkHook)
+		lcdMarkHook();
+}
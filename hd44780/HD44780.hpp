@@ -4,6 +4,9 @@
 // with any assignment of control signals
 //-------------------------------------------------------------------------------------------------
 
+#ifndef _HD44780_
+#define _HD44780_
+
 #include <avr/io.h>
 #include <util/delay.h>
 
@@ -36,6 +39,48 @@
 #define LCD_DB7_PORT	PORTD
 #define LCD_DB7			(1 << PD7)
 
+//-------------------------------------------------------------------------------------------------
+//
+// Asynchronous mode : the bytes are queued, and sent by the TIMER1_COMPA interrupt once the
+// controller is done with the previous one, so the caller does not wait. The interrupts must be
+// enabled, and Timer1 is reserved to the driver. Defining LCD_SYNC sends every byte right away
+// instead, waiting for the controller ; the host tools always do so.
+//
+//-------------------------------------------------------------------------------------------------
+#if defined(__AVR__) && !defined(LCD_SYNC) && !defined(LCD_I2C)
+#define LCD_ASYNC
+#endif
+
+#define LCD_QUEUE_SIZE			64 // bytes waiting to be sent, at most (a power of 2)
+
+//-------------------------------------------------------------------------------------------------
+//
+// I2C backend : defining LCD_I2C drives the display through the PCF8574 expander of the common
+// I2C backpacks, instead of the pins above. Every nibble becomes two writes of the expander (E
+// high, then E low), queued in a buffer sent by the TWI interrupt : the bytes written one after
+// the other join the transaction in progress, so a line of text is a single burst on the bus.
+// The interrupts must be enabled, and the TWI is reserved to the driver.
+//
+//-------------------------------------------------------------------------------------------------
+#define LCD_I2C_ADDRESS			0x27 // 7-bit address of the expander (0x3F for a PCF8574A)
+#define LCD_I2C_SCL				100000 // bus clock, in Hz
+#define LCD_I2C_BUFFER_SIZE		128 // expander writes waiting to be sent, at most (a power of 2)
+
+// Pins of the expander
+#define LCD_I2C_RS				(1 << 0)
+#define LCD_I2C_RW				(1 << 1)
+#define LCD_I2C_E				(1 << 2)
+#define LCD_I2C_BACKLIGHT		(1 << 3)
+#define LCD_I2C_DATA_SHIFT		4 // DB4..DB7 on P4..P7
+
+typedef struct {
+	unsigned int queued;		// bytes queued since the last reset
+	unsigned char maxDepth;		// most bytes (expander writes with LCD_I2C) waiting in the queue at the same time
+	unsigned int stalls;		// bytes which had to wait for room in the queue
+	unsigned int transactions;	// TWI transactions started (LCD_I2C)
+	unsigned int errors;		// TWI transactions ended by a missing acknowledge (LCD_I2C)
+} LCD_QueueStats;
+
 //-------------------------------------------------------------------------------------------------
 //
 // Hitachi HD44780 controller instructions
@@ -78,6 +123,8 @@
 
 #define HD44780_DDRAM_SET				0x80
 
+#define HD44780_DDRAM_LINE_LENGTH		40 // characters of DDRAM per line, of which 16 are visible
+
 //-------------------------------------------------------------------------------------------------
 //
 // Function declarations
@@ -90,4 +137,13 @@ void LCD_WriteText(char *);
 void LCD_GoTo(unsigned char, unsigned char);
 void LCD_Clear(void);
 void LCD_Home(void);
+void LCD_ShiftLeft(void);
 void LCD_Initalize(void);
+void LCD_Restart(void);
+void LCD_Flush(void);
+void LCD_GetQueueStats(LCD_QueueStats *);
+void LCD_ResetQueueStats(void);
+void LCD_Mark(void);
+void LCD_OnMark(void (*)(void));
+
+#endif
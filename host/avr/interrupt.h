@@ -0,0 +1,19 @@
+//-------------------------------------------------------------------------------------------------
+// Host stand-in for <avr/interrupt.h>
+// Interrupt handlers become plain functions, which the host runtime calls when the peripheral
+// they serve would raise them.
+//-------------------------------------------------------------------------------------------------
+
+#ifndef _host_avr_interrupt_
+#define _host_avr_interrupt_
+
+#include <stdint.h>
+
+extern volatile uint8_t Host_InterruptsEnabled;
+
+#define ISR(vector) extern "C" void vector(void)
+
+static inline void sei(void) { Host_InterruptsEnabled = 1; }
+static inline void cli(void) { Host_InterruptsEnabled = 0; }
+
+#endif
@@ -0,0 +1,202 @@
+//-------------------------------------------------------------------------------------------------
+// Host stand-in for <avr/io.h>
+// Lets the firmware sources compile and run on Linux. Every I/O register of the ATmega328p used
+// by the firmware is an object holding its value, whose reads and writes can be hooked by the
+// host backends (LCD emulator, terminal, ...) to model the hardware behind the pins.
+//-------------------------------------------------------------------------------------------------
+
+#ifndef _host_avr_io_
+#define _host_avr_io_
+
+#include <stdint.h>
+
+#ifndef F_CPU
+#define F_CPU 16000000UL
+#endif
+
+//-------------------------------------------------------------------------------------------------
+//
+// Register objects
+//
+//-------------------------------------------------------------------------------------------------
+
+template <typename T>
+class HostRegister {
+public:
+    typedef void (*WriteHook)(T value, T old); // called after every write
+    typedef T (*ReadHook)(T value);            // called on every read, returns the value read
+
+    volatile T value;
+    WriteHook onWrite;
+    ReadHook onRead;
+
+    operator T() const { return onRead ? onRead(value) : value; }
+
+    HostRegister &operator=(T v) {
+        T old = value;
+        value = v;
+        if (onWrite)
+            onWrite(v, old);
+        return *this;
+    }
+
+    HostRegister &operator=(const HostRegister &other) { return *this = (T) other; }
+    HostRegister &operator|=(int v) { return *this = (T) (*this | v); }
+    HostRegister &operator&=(int v) { return *this = (T) (*this & v); }
+    HostRegister &operator^=(int v) { return *this = (T) (*this ^ v); }
+};
+
+typedef HostRegister<uint8_t> HostRegister8;
+typedef HostRegister<uint16_t> HostRegister16;
+
+// Ports
+extern HostRegister8 PINB, DDRB, PORTB;
+extern HostRegister8 PINC, DDRC, PORTC;
+extern HostRegister8 PIND, DDRD, PORTD;
+
+// ADC
+extern HostRegister8 ADCSRA, ADMUX;
+extern HostRegister16 ADC;
+
+// USART0
+extern HostRegister8 UCSR0A, UCSR0B, UCSR0C, UBRR0H, UBRR0L, UDR0;
+
+// Timers
+extern HostRegister8 TCCR0A, TCCR0B, TCNT0, OCR0A, TIMSK0, TIFR0;
+extern HostRegister8 TCCR1A, TCCR1B, TIMSK1, TIFR1;
+extern HostRegister16 TCNT1, OCR1A;
+extern HostRegister8 TCCR2A, TCCR2B, TCNT2, OCR2A, TIMSK2, TIFR2;
+
+// TWI
+extern HostRegister8 TWBR, TWSR, TWCR, TWDR;
+
+// Miscellaneous
+extern HostRegister8 GPIOR0, MCUSR, SMCR, PCICR, PCMSK2, PCIFR;
+
+//-------------------------------------------------------------------------------------------------
+//
+// Bit numbers
+//
+//-------------------------------------------------------------------------------------------------
+
+#define PB0 0
+#define PB1 1
+#define PB2 2
+#define PB3 3
+#define PB4 4
+#define PB5 5
+#define PB6 6
+#define PB7 7
+#define PORTB0 0
+#define PORTB1 1
+#define PORTB2 2
+#define PORTB3 3
+#define PORTB4 4
+#define PORTB5 5
+#define DDB0 0
+#define DDB1 1
+#define DDB2 2
+#define DDB3 3
+#define DDB4 4
+#define DDB5 5
+
+#define PD0 0
+#define PD1 1
+#define PD2 2
+#define PD3 3
+#define PD4 4
+#define PD5 5
+#define PD6 6
+#define PD7 7
+#define PIND0 0
+#define PIND1 1
+#define PIND2 2
+#define PIND3 3
+
+#define PC4 4
+#define PC5 5
+
+#define ADEN 7
+#define ADSC 6
+#define ADATE 5
+#define ADIF 4
+#define ADIE 3
+#define ADPS2 2
+#define ADPS1 1
+#define ADPS0 0
+#define REFS1 7
+#define REFS0 6
+#define ADLAR 5
+
+#define RXC0 7
+#define TXC0 6
+#define UDRE0 5
+#define FE0 4
+#define DOR0 3
+#define UPE0 2
+#define U2X0 1
+#define RXCIE0 7
+#define TXCIE0 6
+#define UDRIE0 5
+#define RXEN0 4
+#define TXEN0 3
+#define UCSZ02 2
+#define UCSZ01 2
+#define UCSZ00 1
+
+#define WGM01 1
+#define WGM00 0
+#define CS02 2
+#define CS01 1
+#define CS00 0
+#define OCIE0A 1
+#define TOIE0 0
+#define OCF0A 1
+#define TOV0 0
+
+#define WGM13 4
+#define WGM12 3
+#define CS12 2
+#define CS11 1
+#define CS10 0
+#define OCIE1A 1
+#define TOIE1 0
+#define OCF1A 1
+#define TOV1 0
+
+#define WGM21 1
+#define WGM20 0
+#define CS22 2
+#define CS21 1
+#define CS20 0
+#define OCIE2A 1
+#define TOIE2 0
+
+#define TWINT 7
+#define TWEA 6
+#define TWSTA 5
+#define TWSTO 4
+#define TWWC 3
+#define TWEN 2
+#define TWIE 0
+#define TWPS1 1
+#define TWPS0 0
+
+#define WDRF 3
+#define BORF 2
+#define EXTRF 1
+#define PORF 0
+
+#define SM2 3
+#define SM1 2
+#define SM0 1
+#define SE 0
+
+#define PCIE2 2
+#define PCIF2 2
+#define PCINT16 0
+#define PCINT17 1
+#define PCINT18 2
+#define PCINT19 3
+
+#endif
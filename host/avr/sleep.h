@@ -0,0 +1,34 @@
+//-------------------------------------------------------------------------------------------------
+// Host stand-in for <avr/sleep.h>
+// Sleeping lets the simulated time run until the next timer interrupt, which wakes the CPU up.
+//-------------------------------------------------------------------------------------------------
+
+#ifndef _host_avr_sleep_
+#define _host_avr_sleep_
+
+#include <avr/io.h>
+#include "../host.hpp"
+
+#define SLEEP_MODE_IDLE 0
+#define SLEEP_MODE_ADC (1 << SM0)
+#define SLEEP_MODE_PWR_DOWN (1 << SM1)
+#define SLEEP_MODE_PWR_SAVE ((1 << SM0) | (1 << SM1))
+
+#define set_sleep_mode(mode) (SMCR = (SMCR & ~((1 << SM2) | (1 << SM1) | (1 << SM0))) | (mode))
+#define sleep_enable() (SMCR |= (1 << SE))
+#define sleep_disable() (SMCR &= ~(1 << SE))
+
+static inline void sleep_cpu(void)
+{
+    if (SMCR & (1 << SE))
+        Host_Sleep();
+}
+
+static inline void sleep_mode(void)
+{
+    sleep_enable();
+    sleep_cpu();
+    sleep_disable();
+}
+
+#endif
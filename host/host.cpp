@@ -0,0 +1,427 @@
+#include "host.hpp"
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <time.h>
+
+// Interrupt handlers : only the ones defined by the linked firmware sources run
+extern "C" {
+void TIMER0_COMPA_vect(void) __attribute__((weak));
+void TIMER1_COMPA_vect(void) __attribute__((weak));
+void TIMER2_COMPA_vect(void) __attribute__((weak));
+void PCINT2_vect(void) __attribute__((weak));
+void USART_RX_vect(void) __attribute__((weak));
+void TWI_vect(void) __attribute__((weak));
+}
+
+static uint8_t ReadUart(uint8_t value);
+static void WriteTwi(uint8_t value, uint8_t old);
+
+// Interrupt flag registers : writing a one clears a flag, writing a zero leaves it as it is
+template <HostRegister8 &flags>
+static void ClearFlags(uint8_t value, uint8_t old)
+{
+    flags.value = old & ~value;
+}
+
+// Ports : the pins read high, as with the pull-ups of the released buttons
+HostRegister8 PINB = { 0xFF, 0, 0 }, DDRB, PORTB;
+HostRegister8 PINC = { 0xFF, 0, 0 }, DDRC, PORTC;
+HostRegister8 PIND = { 0xFF, 0, 0 }, DDRD, PORTD;
+
+// ADC
+HostRegister8 ADCSRA, ADMUX;
+HostRegister16 ADC;
+
+// USART0 : the transmit buffer is always empty, UDR0 reads the received byte
+HostRegister8 UCSR0A = { 1 << UDRE0, 0, 0 }, UCSR0B, UCSR0C, UBRR0H, UBRR0L, UDR0 = { 0, 0, ReadUart };
+
+// Timers
+HostRegister8 TCCR0A, TCCR0B, TCNT0, OCR0A, TIMSK0, TIFR0 = { 0, ClearFlags<TIFR0>, 0 };
+HostRegister8 TCCR1A, TCCR1B, TIMSK1, TIFR1 = { 0, ClearFlags<TIFR1>, 0 };
+HostRegister16 TCNT1, OCR1A;
+HostRegister8 TCCR2A, TCCR2B, TCNT2, OCR2A, TIMSK2, TIFR2 = { 0, ClearFlags<TIFR2>, 0 };
+
+// TWI : writing TWCR with TWINT set starts the next operation of the master
+HostRegister8 TWBR, TWSR, TWCR = { 0, WriteTwi, 0 }, TWDR;
+
+// Miscellaneous : the program starts as after a power-on reset
+HostRegister8 GPIOR0, MCUSR = { 1 << PORF, 0, 0 }, SMCR, PCICR, PCMSK2, PCIFR = { 0, ClearFlags<PCIFR>, 0 };
+
+volatile uint8_t Host_InterruptsEnabled = 0;
+
+static uint64_t hostNanos = 0; // simulated time
+static bool advancing = false; // whether the time is being advanced, by a delay or a sleep
+
+// Pacing on the wall clock
+#define HOST_PACE_SLACK_NS 1000000
+static bool realTime = false;
+static uint64_t wallStart, simulatedStart;
+
+// Poll hook
+static void (*pollHook)(void) = 0;
+static uint64_t pollPeriod, nextPoll;
+
+// Bytes received on RXD0, waiting for UDR0 to be free
+#define HOST_RX_SIZE 256
+static uint8_t rxQueue[HOST_RX_SIZE];
+static uint16_t rxHead = 0, rxLength = 0;
+static uint8_t rxByte; // byte in UDR0
+
+// TWI master, and the device attached to the bus
+static uint64_t twiDoneAt = 0;  // simulated time at which the operation in progress completes, 0 if none
+static uint8_t twiStatus;       // status of the operation in progress, once it completes
+static bool twiStarted = false; // whether a start condition was sent, and not a stop
+static bool twiAddressed = false; // whether the address was sent since the start condition
+static uint8_t twiByte;         // data byte in progress, delivered to the device once sent
+static uint8_t twiAddress;      // 7-bit address of the device
+static void (*twiReceive)(uint8_t) = 0;
+
+//-------------------------------------------------------------------------------------------------
+//
+// Timers
+//
+//-------------------------------------------------------------------------------------------------
+
+// Prescalers of the clock select values 0 to 7 (0 : stopped, 6 and 7 : external clock, unsupported)
+static const uint16_t PRESCALERS[8] = { 0, 1, 8, 64, 256, 1024, 0, 0 };
+static const uint16_t PRESCALERS_TIMER2[8] = { 0, 1, 8, 32, 64, 128, 256, 1024 };
+
+/**
+ * Model of a timer counting in CTC or normal mode, with its compare match A interrupt.
+ */
+template <typename T>
+struct HostTimer {
+    HostRegister<T> &tcnt, &ocr;
+    HostRegister8 &tccrA, &tccrB, &timsk, &tifr;
+    const uint16_t *prescalers;
+    bool ctcInB;                // whether the CTC bit is WGMx2 of TCCRxB, instead of WGMx1 of TCCRxA
+    void (*vector)(void);
+    uint16_t phase;             // CPU cycles since the last timer step
+
+    uint16_t Prescaler() const { return prescalers[tccrB.value & 0x07]; }
+
+    uint32_t Top() const
+    {
+        bool ctc = ctcInB ? (tccrB.value & (1 << 3)) : (tccrA.value & (1 << 1));
+        return ctc && tcnt.value <= ocr.value ? ocr.value : (T) ~0;
+    }
+
+    /**
+     * CPU cycles until the next compare match, or 0 if the timer is stopped.
+     */
+    uint64_t CyclesToMatch() const
+    {
+        uint16_t prescaler = Prescaler();
+        if (prescaler == 0)
+            return 0;
+        uint32_t period = Top() + 1;
+        uint32_t steps = (ocr.value + period - tcnt.value) % period;
+        if (steps == 0)
+            steps = period;
+        return (uint64_t) steps * prescaler - phase;
+    }
+
+    /**
+     * Counts a number of CPU cycles, setting the compare match and overflow flags on the way.
+     */
+    void Advance(uint64_t cycles)
+    {
+        uint16_t prescaler = Prescaler();
+        if (prescaler == 0)
+            return;
+        uint64_t steps = (phase + cycles) / prescaler;
+        phase = (phase + cycles) % prescaler;
+        if (steps == 0)
+            return;
+
+        uint32_t period = Top() + 1;
+        uint32_t toMatch = (ocr.value + period - tcnt.value) % period;
+        if (toMatch == 0)
+            toMatch = period;
+        if (steps >= toMatch)
+            tifr.value |= (1 << 1); // OCFxA
+        if (tcnt.value + steps >= period && period == (uint32_t) (T) ~0 + 1)
+            tifr.value |= (1 << 0); // TOVx
+        tcnt.value = (T) ((tcnt.value + steps) % period);
+    }
+
+    bool Pending() const
+    {
+        return (tifr.value & (1 << 1)) && (timsk.value & (1 << 1)) && vector;
+    }
+};
+
+static HostTimer<uint8_t> timer0 = { TCNT0, OCR0A, TCCR0A, TCCR0B, TIMSK0, TIFR0, PRESCALERS, false, TIMER0_COMPA_vect, 0 };
+static HostTimer<uint16_t> timer1 = { TCNT1, OCR1A, TCCR1A, TCCR1B, TIMSK1, TIFR1, PRESCALERS, true, TIMER1_COMPA_vect, 0 };
+static HostTimer<uint8_t> timer2 = { TCNT2, OCR2A, TCCR2A, TCCR2B, TIMSK2, TIFR2, PRESCALERS_TIMER2, false, TIMER2_COMPA_vect, 0 };
+
+//-------------------------------------------------------------------------------------------------
+//
+// TWI
+//
+//-------------------------------------------------------------------------------------------------
+
+// Status codes of the master transmitter
+#define TW_START        0x08
+#define TW_REP_START    0x10
+#define TW_MT_SLA_ACK   0x18
+#define TW_MT_SLA_NACK  0x20
+#define TW_MT_DATA_ACK  0x28
+#define TW_MT_DATA_NACK 0x30
+
+/**
+ * Duration of a period of SCL, with the bit rate and the prescaler of TWBR and TWSR.
+ */
+static uint64_t TwiBitNanos(void)
+{
+    uint64_t cycles = 16 + 2 * (uint64_t) TWBR.value * (1 << (2 * (TWSR.value & 0x03)));
+    return cycles * 1000000000 / F_CPU;
+}
+
+/**
+ * Starts what a write of TWCR with TWINT set asks for : a stop condition takes effect at once,
+ * a start condition lasts one period of SCL, and a byte nine (eight bits and the acknowledge).
+ */
+static void WriteTwi(uint8_t value, uint8_t old)
+{
+    if (!(value & (1 << TWINT))) {
+        TWCR.value = value | (old & (1 << TWINT)); // writing a zero leaves the flag as it is
+        return;
+    }
+    TWCR.value = value & ~(1 << TWINT);
+    if (!(value & (1 << TWEN)))
+        return;
+
+    if (value & (1 << TWSTO)) {
+        twiStarted = false;
+        twiDoneAt = 0;
+        TWCR.value &= ~(1 << TWSTO);
+    } else if (value & (1 << TWSTA)) {
+        twiStatus = twiStarted ? TW_REP_START : TW_START;
+        twiStarted = true;
+        twiAddressed = false;
+        twiDoneAt = Host_Nanos() + TwiBitNanos();
+    } else if (twiStarted && !twiAddressed) {
+        bool ack = twiReceive && TWDR.value == (twiAddress << 1); // write to the device
+        twiStatus = ack ? TW_MT_SLA_ACK : TW_MT_SLA_NACK;
+        twiAddressed = true;
+        twiDoneAt = Host_Nanos() + 9 * TwiBitNanos();
+    } else if (twiStarted) {
+        twiStatus = TW_MT_DATA_ACK;
+        twiByte = TWDR.value;
+        twiDoneAt = Host_Nanos() + 9 * TwiBitNanos();
+    }
+}
+
+/**
+ * Completes the operation in progress : the byte reaches the device, and TWINT is set.
+ */
+static void CompleteTwi(void)
+{
+    twiDoneAt = 0;
+    if (twiStatus == TW_MT_DATA_ACK)
+        twiReceive(twiByte);
+    TWSR.value = (TWSR.value & 0x03) | twiStatus;
+    TWCR.value |= (1 << TWINT);
+}
+
+//-------------------------------------------------------------------------------------------------
+//
+// Interrupts
+//
+//-------------------------------------------------------------------------------------------------
+
+static uint8_t ReadUart(uint8_t value)
+{
+    UCSR0A.value &= ~(1 << RXC0);
+    return rxByte;
+}
+
+static void Run(void (*vector)(void))
+{
+    Host_InterruptsEnabled = 0;
+    vector();
+    Host_InterruptsEnabled = 1;
+}
+
+/**
+ * Runs the interrupts whose flag is set and which are enabled, in the priority order of the
+ * ATmega328p, as long as the interrupts are enabled.
+ */
+static void Dispatch(void)
+{
+    for (;;) {
+        if (!(UCSR0A.value & (1 << RXC0)) && rxLength > 0) {
+            rxByte = rxQueue[rxHead];
+            rxHead = (rxHead + 1) % HOST_RX_SIZE;
+            rxLength--;
+            UCSR0A.value |= (1 << RXC0);
+        }
+        if (!Host_InterruptsEnabled)
+            return;
+
+        if ((PCIFR.value & (1 << PCIF2)) && (PCICR.value & (1 << PCIE2)) && PCINT2_vect) {
+            PCIFR.value &= ~(1 << PCIF2);
+            Run(PCINT2_vect);
+        } else if (timer2.Pending()) {
+            TIFR2.value &= ~(1 << 1);
+            Run(timer2.vector);
+        } else if (timer1.Pending()) {
+            TIFR1.value &= ~(1 << 1);
+            Run(timer1.vector);
+        } else if (timer0.Pending()) {
+            TIFR0.value &= ~(1 << 1);
+            Run(timer0.vector);
+        } else if ((UCSR0A.value & (1 << RXC0)) && (UCSR0B.value & (1 << RXCIE0)) && USART_RX_vect) {
+            Run(USART_RX_vect); // reading UDR0 clears RXC0
+        } else if ((TWCR.value & (1 << TWINT)) && (TWCR.value & (1 << TWIE)) && TWI_vect) {
+            Run(TWI_vect); // the handler clears TWINT
+        } else {
+            return;
+        }
+    }
+}
+
+//-------------------------------------------------------------------------------------------------
+//
+// Time
+//
+//-------------------------------------------------------------------------------------------------
+
+static uint64_t Cycles(uint64_t ns)
+{
+    return ns * (F_CPU / 1000000) / 1000;
+}
+
+static uint64_t WallNanos(void)
+{
+    timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t) t.tv_sec * 1000000000 + t.tv_nsec;
+}
+
+/**
+ * Simulated time of the next interrupt of a timer or of the TWI, or 0 if none is expected.
+ */
+static uint64_t NextEvent(void)
+{
+    uint64_t next = 0, cycles;
+    uint64_t now = Cycles(hostNanos);
+    if (timer0.vector && (TIMSK0.value & (1 << OCIE0A)) && (cycles = timer0.CyclesToMatch()) != 0)
+        next = now + cycles;
+    if (timer1.vector && (TIMSK1.value & (1 << OCIE1A)) && (cycles = timer1.CyclesToMatch()) != 0)
+        next = next == 0 || now + cycles < next ? now + cycles : next;
+    if (timer2.vector && (TIMSK2.value & (1 << OCIE2A)) && (cycles = timer2.CyclesToMatch()) != 0)
+        next = next == 0 || now + cycles < next ? now + cycles : next;
+    if (next != 0)
+        next = (next * 1000 + F_CPU / 1000000 - 1) / (F_CPU / 1000000); // first nanosecond of the cycle of the match
+    if (twiDoneAt != 0 && (next == 0 || twiDoneAt < next))
+        next = twiDoneAt;
+    return next;
+}
+
+/**
+ * Moves the simulated time and the timers to a given time.
+ */
+static void MoveTo(uint64_t ns)
+{
+    uint64_t cycles = Cycles(ns) - Cycles(hostNanos);
+    hostNanos = ns;
+    timer0.Advance(cycles);
+    timer1.Advance(cycles);
+    timer2.Advance(cycles);
+    if (twiDoneAt != 0 && hostNanos >= twiDoneAt)
+        CompleteTwi();
+}
+
+/**
+ * In real time, sleeps while the simulated time is ahead of the wall clock by more than
+ * HOST_PACE_SLACK_NS, so the short delays do not each cost a system call.
+ */
+static void Pace(void)
+{
+    if (!realTime)
+        return;
+    uint64_t simulated = hostNanos - simulatedStart;
+    uint64_t wall = WallNanos() - wallStart;
+    if (simulated > wall + HOST_PACE_SLACK_NS) {
+        timespec t = { (time_t) ((simulated - wall) / 1000000000), (long) ((simulated - wall) % 1000000000) };
+        nanosleep(&t, 0);
+    }
+}
+
+uint64_t Host_Nanos(void)
+{
+    return hostNanos;
+}
+
+void Host_Delay(uint64_t ns)
+{
+    if (advancing)
+        return;
+    advancing = true;
+
+    uint64_t end = hostNanos + ns;
+    Dispatch();
+    while (hostNanos < end) {
+        uint64_t next = NextEvent();
+        if (next == 0 || next > end)
+            next = end;
+        if (pollHook && nextPoll < next)
+            next = nextPoll > hostNanos ? nextPoll : hostNanos;
+        MoveTo(next);
+        Dispatch();
+        if (pollHook && hostNanos >= nextPoll) {
+            nextPoll = hostNanos + pollPeriod;
+            pollHook();
+            Dispatch();
+        }
+        Pace();
+    }
+
+    advancing = false;
+}
+
+void Host_Sleep(void)
+{
+    if (advancing)
+        return;
+    uint64_t next = NextEvent();
+    if (next > hostNanos)
+        Host_Delay(next - hostNanos);
+    else
+        Dispatch(); // no event to wake up the CPU : the pending interrupts, if any
+}
+
+void Host_RealTime(bool on)
+{
+    realTime = on;
+    wallStart = WallNanos();
+    simulatedStart = hostNanos;
+}
+
+void Host_Poll(void (*poll)(void), uint64_t period_ns)
+{
+    pollHook = poll;
+    pollPeriod = period_ns;
+    nextPoll = hostNanos + period_ns;
+}
+
+void Host_PinChange(uint8_t pins)
+{
+    if (PCMSK2.value & pins)
+        PCIFR.value |= (1 << PCIF2);
+}
+
+void Host_UartReceive(uint8_t byte)
+{
+    if (rxLength == HOST_RX_SIZE)
+        return; // overrun : the byte is lost
+    rxQueue[(rxHead + rxLength++) % HOST_RX_SIZE] = byte;
+}
+
+void Host_AttachTwi(uint8_t address, void (*receive)(uint8_t))
+{
+    twiAddress = address;
+    twiReceive = receive;
+}
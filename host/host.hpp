@@ -0,0 +1,36 @@
+//-------------------------------------------------------------------------------------------------
+// Host runtime
+// Simulated time of the firmware when it runs on Linux : the busy-wait delays of <util/delay.h>
+// advance a simulated clock instead of spinning, so the time the firmware would spend on the
+// board can be measured.
+//
+// While the simulated time runs, the runtime plays the peripherals raising interrupts : the
+// compare match of Timer0, Timer1 and Timer2 (in CTC or normal mode, with the prescaler of
+// their clock select bits), the pin change interrupt of PORTD, the reception of the USART, and
+// the TWI master writing to a device attached with Host_AttachTwi (at the bit rate of TWBR).
+// An enabled interrupt runs when the time advances with the interrupts enabled, so the handlers
+// never run in the middle of a statement of the firmware. Delays inside an interrupt handler or
+// a poll hook take no time.
+//-------------------------------------------------------------------------------------------------
+
+#ifndef _host_
+#define _host_
+
+#include <stdint.h>
+
+//-------------------------------------------------------------------------------------------------
+//
+// Function declarations
+//
+//-------------------------------------------------------------------------------------------------
+
+uint64_t Host_Nanos(void);          // simulated time since the start of the program, in ns
+void Host_Delay(uint64_t ns);       // lets the simulated time run for a given duration
+void Host_Sleep(void);              // sleep_cpu : lets the time run until the next timer interrupt
+void Host_RealTime(bool on);        // keeps the simulated time from running ahead of the wall clock
+void Host_Poll(void (*poll)(void), uint64_t period_ns); // calls poll every period of simulated time
+void Host_PinChange(uint8_t pins);  // PIND pins which changed, raising PCINT2 when they are enabled
+void Host_UartReceive(uint8_t byte); // byte arriving on RXD0, queued until UDR0 is read
+void Host_AttachTwi(uint8_t address, void (*receive)(uint8_t)); // device acknowledging the writes to a 7-bit address
+
+#endif
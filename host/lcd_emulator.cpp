@@ -0,0 +1,373 @@
+#include "lcd_emulator.hpp"
+#include "host.hpp"
+#include "../hd44780/HD44780.hpp"
+#include <stdio.h>
+#include <string.h>
+
+// Execution times of the instructions at 270 kHz (HD44780 datasheet, table 6)
+#define EXEC_CLEAR_NS 1520000
+#define EXEC_HOME_NS 1520000
+#define EXEC_INSTRUCTION_NS 37000
+#define EXEC_DATA_NS 41000 // 37 us, plus 4 us to update the address counter
+
+// Size of a character in the captured images, in pixels
+#define PPM_SCALE 3
+#define PPM_CELL_W 6 // 5 pixels and a gap
+#define PPM_CELL_H 9 // 8 pixels and a gap
+
+// 5x7 font of the characters 0x20 to 0x7E : 5 columns per character, bit 0 at the top
+static const uint8_t font5x7[95][5] = {
+    {0x00,0x00,0x00,0x00,0x00}, {0x00,0x00,0x5F,0x00,0x00}, {0x00,0x07,0x00,0x07,0x00}, {0x14,0x7F,0x14,0x7F,0x14},
+    {0x24,0x2A,0x7F,0x2A,0x12}, {0x23,0x13,0x08,0x64,0x62}, {0x36,0x49,0x55,0x22,0x50}, {0x00,0x05,0x03,0x00,0x00},
+    {0x00,0x1C,0x22,0x41,0x00}, {0x00,0x41,0x22,0x1C,0x00}, {0x14,0x08,0x3E,0x08,0x14}, {0x08,0x08,0x3E,0x08,0x08},
+    {0x00,0x50,0x30,0x00,0x00}, {0x08,0x08,0x08,0x08,0x08}, {0x00,0x60,0x60,0x00,0x00}, {0x20,0x10,0x08,0x04,0x02},
+    {0x3E,0x51,0x49,0x45,0x3E}, {0x00,0x42,0x7F,0x40,0x00}, {0x42,0x61,0x51,0x49,0x46}, {0x21,0x41,0x45,0x4B,0x31},
+    {0x18,0x14,0x12,0x7F,0x10}, {0x27,0x45,0x45,0x45,0x39}, {0x3C,0x4A,0x49,0x49,0x30}, {0x01,0x71,0x09,0x05,0x03},
+    {0x36,0x49,0x49,0x49,0x36}, {0x06,0x49,0x49,0x29,0x1E}, {0x00,0x36,0x36,0x00,0x00}, {0x00,0x56,0x36,0x00,0x00},
+    {0x08,0x14,0x22,0x41,0x00}, {0x14,0x14,0x14,0x14,0x14}, {0x00,0x41,0x22,0x14,0x08}, {0x02,0x01,0x51,0x09,0x06},
+    {0x32,0x49,0x79,0x41,0x3E}, {0x7E,0x11,0x11,0x11,0x7E}, {0x7F,0x49,0x49,0x49,0x36}, {0x3E,0x41,0x41,0x41,0x22},
+    {0x7F,0x41,0x41,0x22,0x1C}, {0x7F,0x49,0x49,0x49,0x41}, {0x7F,0x09,0x09,0x09,0x01}, {0x3E,0x41,0x49,0x49,0x7A},
+    {0x7F,0x08,0x08,0x08,0x7F}, {0x00,0x41,0x7F,0x41,0x00}, {0x20,0x40,0x41,0x3F,0x01}, {0x7F,0x08,0x14,0x22,0x41},
+    {0x7F,0x40,0x40,0x40,0x40}, {0x7F,0x02,0x0C,0x02,0x7F}, {0x7F,0x04,0x08,0x10,0x7F}, {0x3E,0x41,0x41,0x41,0x3E},
+    {0x7F,0x09,0x09,0x09,0x06}, {0x3E,0x41,0x51,0x21,0x5E}, {0x7F,0x09,0x19,0x29,0x46}, {0x46,0x49,0x49,0x49,0x31},
+    {0x01,0x01,0x7F,0x01,0x01}, {0x3F,0x40,0x40,0x40,0x3F}, {0x1F,0x20,0x40,0x20,0x1F}, {0x3F,0x40,0x38,0x40,0x3F},
+    {0x63,0x14,0x08,0x14,0x63}, {0x07,0x08,0x70,0x08,0x07}, {0x61,0x51,0x49,0x45,0x43}, {0x00,0x7F,0x41,0x41,0x00},
+    {0x02,0x04,0x08,0x10,0x20}, {0x00,0x41,0x41,0x7F,0x00}, {0x04,0x02,0x01,0x02,0x04}, {0x40,0x40,0x40,0x40,0x40},
+    {0x00,0x01,0x02,0x04,0x00}, {0x20,0x54,0x54,0x54,0x78}, {0x7F,0x48,0x44,0x44,0x38}, {0x38,0x44,0x44,0x44,0x20},
+    {0x38,0x44,0x44,0x48,0x7F}, {0x38,0x54,0x54,0x54,0x18}, {0x08,0x7E,0x09,0x01,0x02}, {0x0C,0x52,0x52,0x52,0x3E},
+    {0x7F,0x08,0x04,0x04,0x78}, {0x00,0x44,0x7D,0x40,0x00}, {0x20,0x40,0x44,0x3D,0x00}, {0x7F,0x10,0x28,0x44,0x00},
+    {0x00,0x41,0x7F,0x40,0x00}, {0x7C,0x04,0x18,0x04,0x78}, {0x7C,0x08,0x04,0x04,0x78}, {0x38,0x44,0x44,0x44,0x38},
+    {0x7C,0x14,0x14,0x14,0x08}, {0x08,0x14,0x14,0x18,0x7C}, {0x7C,0x08,0x04,0x04,0x08}, {0x48,0x54,0x54,0x54,0x20},
+    {0x04,0x3F,0x44,0x40,0x20}, {0x3C,0x40,0x40,0x20,0x7C}, {0x1C,0x20,0x40,0x20,0x1C}, {0x3C,0x40,0x30,0x40,0x3C},
+    {0x44,0x28,0x10,0x28,0x44}, {0x0C,0x50,0x50,0x50,0x3C}, {0x44,0x64,0x54,0x4C,0x44}, {0x00,0x08,0x36,0x41,0x00},
+    {0x00,0x00,0x7F,0x00,0x00}, {0x00,0x41,0x36,0x08,0x00}, {0x08,0x08,0x2A,0x1C,0x08},
+};
+
+// Controller state
+static uint8_t ddram[2][LCDEMU_LINE_LENGTH];
+static uint8_t cgram[64];
+static uint8_t address;          // address counter
+static bool addressCgram;        // whether the address counter points to CGRAM, or DDRAM
+static bool increment;           // entry mode I/D
+static bool shiftOnWrite;        // entry mode S
+static bool displayOn;
+static uint8_t shift;            // display shift, in characters
+static bool eightBit;            // interface data length
+static bool pendingHigh;         // whether the high nibble of a byte has been received in 4-bit mode
+static uint8_t highNibble;
+static uint64_t busyUntil;       // simulated time at which the current instruction ends
+
+// Frames
+static LcdEmuFrame frame;
+static FILE *captureText = NULL;
+static char captureDirectory[256];
+static bool capturePpm = false;
+
+/**
+ * Moves the address counter one step forward or backward. In DDRAM, the address wraps from the
+ * end of the first line to the beginning of the second one, and back.
+ */
+static void StepAddress(bool forward)
+{
+    if (addressCgram) {
+        address = (address + (forward ? 1 : 63)) & 0x3F;
+        return;
+    }
+    uint8_t line = address >= 0x40;
+    uint8_t column = address & 0x3F;
+    if (forward) {
+        if (++column == LCDEMU_LINE_LENGTH) {
+            column = 0;
+            line ^= 1;
+        }
+    } else {
+        if (column-- == 0) {
+            column = LCDEMU_LINE_LENGTH - 1;
+            line ^= 1;
+        }
+    }
+    address = line * 0x40 + column;
+}
+
+static void ShiftDisplay(bool right)
+{
+    shift = (shift + (right ? LCDEMU_LINE_LENGTH - 1 : 1)) % LCDEMU_LINE_LENGTH;
+}
+
+/**
+ * Executes an instruction, and returns its execution time.
+ */
+static uint64_t ExecuteInstruction(uint8_t instruction)
+{
+    if (instruction & HD44780_DDRAM_SET) {
+        uint8_t column = (instruction & 0x3F) % LCDEMU_LINE_LENGTH;
+        address = (instruction & 0x40) | column;
+        addressCgram = false;
+    } else if (instruction & HD44780_CGRAM_SET) {
+        address = instruction & 0x3F;
+        addressCgram = true;
+    } else if (instruction & HD44780_FUNCTION_SET) {
+        eightBit = instruction & HD44780_8_BIT;
+        pendingHigh = false;
+    } else if (instruction & HD44780_DISPLAY_CURSOR_SHIFT) {
+        if (instruction & HD44780_SHIFT_DISPLAY)
+            ShiftDisplay(instruction & HD44780_SHIFT_RIGHT);
+        else
+            StepAddress(instruction & HD44780_SHIFT_RIGHT); // the cursor moves as told, whatever the entry mode
+    } else if (instruction & HD44780_DISPLAY_ONOFF) {
+        displayOn = instruction & HD44780_DISPLAY_ON;
+    } else if (instruction & HD44780_ENTRY_MODE) {
+        increment = instruction & HD44780_EM_INCREMENT;
+        shiftOnWrite = instruction & HD44780_EM_SHIFT_DISPLAY;
+    } else if (instruction & HD44780_HOME) {
+        address = 0;
+        addressCgram = false;
+        shift = 0;
+        return EXEC_HOME_NS;
+    } else if (instruction & HD44780_CLEAR) {
+        memset(ddram, ' ', sizeof(ddram));
+        address = 0;
+        addressCgram = false;
+        shift = 0;
+        increment = true;
+        return EXEC_CLEAR_NS;
+    }
+    return EXEC_INSTRUCTION_NS;
+}
+
+/**
+ * Writes a byte to the RAM pointed by the address counter.
+ */
+static uint64_t ExecuteData(uint8_t data)
+{
+    if (addressCgram)
+        cgram[address] = data & 0x1F;
+    else
+        ddram[address >= 0x40][address & 0x3F] = data;
+    StepAddress(increment);
+    if (shiftOnWrite && !addressCgram)
+        ShiftDisplay(!increment);
+    return EXEC_DATA_NS;
+}
+
+static void Execute(bool rs, uint8_t byte)
+{
+    uint64_t now = Host_Nanos();
+    if (now < busyUntil)
+        frame.late++;
+
+    uint64_t duration;
+    if (rs) {
+        duration = ExecuteData(byte);
+        frame.data++;
+    } else {
+        duration = ExecuteInstruction(byte);
+        frame.commands++;
+    }
+    frame.busy_ns += duration;
+    busyUntil = (now > busyUntil ? now : busyUntil) + duration;
+}
+
+void LcdEmu_Reset(void)
+{
+    memset(ddram, ' ', sizeof(ddram));
+    memset(cgram, 0, sizeof(cgram));
+    address = 0;
+    addressCgram = false;
+    increment = true;
+    shiftOnWrite = false;
+    displayOn = false;
+    shift = 0;
+    eightBit = true;
+    pendingHigh = false;
+    busyUntil = 0;
+    memset(&frame, 0, sizeof(frame));
+    frame.start_ns = Host_Nanos();
+}
+
+void LcdEmu_Strobe(bool rs, uint8_t nibble)
+{
+    nibble &= 0x0F;
+    if (eightBit) {
+        // Only DB7..DB4 are wired : DB3..DB0 read as 0
+        Execute(rs, nibble << 4);
+    } else if (!pendingHigh) {
+        highNibble = nibble;
+        pendingHigh = true;
+    } else {
+        pendingHigh = false;
+        Execute(rs, (highNibble << 4) | nibble);
+    }
+}
+
+/**
+ * Latches the data lines on the falling edge of E.
+ */
+static void OnEnablePortWrite(uint8_t value, uint8_t old)
+{
+    if (!(old & LCD_E) || (value & LCD_E))
+        return;
+
+    uint8_t nibble = ((LCD_DB4_PORT.value & LCD_DB4) ? 0x01 : 0)
+                   | ((LCD_DB5_PORT.value & LCD_DB5) ? 0x02 : 0)
+                   | ((LCD_DB6_PORT.value & LCD_DB6) ? 0x04 : 0)
+                   | ((LCD_DB7_PORT.value & LCD_DB7) ? 0x08 : 0);
+    LcdEmu_Strobe(LCD_RS_PORT.value & LCD_RS, nibble);
+}
+
+void LcdEmu_AttachParallel(void)
+{
+    LcdEmu_Reset();
+    LCD_E_PORT.onWrite = OnEnablePortWrite;
+}
+
+/**
+ * PCF8574 of an I2C backpack : latches the data lines on the falling edge of E, between two
+ * writes of the expander.
+ */
+static uint8_t expanderPins = 0;
+
+static void OnExpanderWrite(uint8_t value)
+{
+    uint8_t old = expanderPins;
+    expanderPins = value;
+    if (!(old & LCD_I2C_E) || (value & LCD_I2C_E))
+        return;
+    LcdEmu_Strobe(value & LCD_I2C_RS, value >> LCD_I2C_DATA_SHIFT);
+}
+
+void LcdEmu_AttachI2c(uint8_t address)
+{
+    LcdEmu_Reset();
+    expanderPins = 0;
+    Host_AttachTwi(address, OnExpanderWrite);
+}
+
+char LcdEmu_Char(uint8_t x, uint8_t y)
+{
+    return ddram[y & 1][(x + shift) % LCDEMU_LINE_LENGTH];
+}
+
+void LcdEmu_Line(uint8_t y, char *line)
+{
+    for (uint8_t x = 0 ; x < LCDEMU_COLUMNS ; x++)
+        line[x] = LcdEmu_Char(x, y);
+    line[LCDEMU_COLUMNS] = '\0';
+}
+
+uint8_t LcdEmu_Shift(void)
+{
+    return shift;
+}
+
+bool LcdEmu_DisplayOn(void)
+{
+    return displayOn;
+}
+
+void LcdEmu_Capture(const char *directory, bool ppm)
+{
+    if (captureText != NULL)
+        fclose(captureText);
+    captureText = NULL;
+    if (directory == NULL)
+        return;
+
+    snprintf(captureDirectory, sizeof(captureDirectory), "%s", directory);
+    capturePpm = ppm;
+
+    char path[300];
+    snprintf(path, sizeof(path), "%s/frames.txt", directory);
+    captureText = fopen(path, "w");
+    if (captureText == NULL)
+        perror(path);
+}
+
+/**
+ * Returns the 5 columns of pixels of a character, bit 0 at the top.
+ */
+static void Glyph(uint8_t code, uint8_t columns[5])
+{
+    if (code < 16) {
+        // CGRAM : one byte per row, bit 4 on the left
+        for (int c = 0 ; c < 5 ; c++) {
+            columns[c] = 0;
+            for (int r = 0 ; r < 8 ; r++)
+                if (cgram[(code & 7) * 8 + r] & (0x10 >> c))
+                    columns[c] |= 1 << r;
+        }
+    } else if (code >= 0x20 && code <= 0x7E) {
+        memcpy(columns, font5x7[code - 0x20], 5);
+    } else {
+        memset(columns, 0x7F, 5);
+    }
+}
+
+static void WritePpm(uint32_t index)
+{
+    const int width = (LCDEMU_COLUMNS * PPM_CELL_W + 1) * PPM_SCALE;
+    const int height = (LCDEMU_LINES * PPM_CELL_H + 1) * PPM_SCALE;
+    static const uint8_t background[3] = { 0x5A, 0x8C, 0x1E };
+    static const uint8_t pixelOff[3] = { 0x6E, 0xA0, 0x28 };
+    static const uint8_t pixelOn[3] = { 0x10, 0x20, 0x08 };
+
+    char path[300];
+    snprintf(path, sizeof(path), "%s/frame_%05u.ppm", captureDirectory, (unsigned) index);
+    FILE *f = fopen(path, "wb");
+    if (f == NULL) {
+        perror(path);
+        return;
+    }
+    fprintf(f, "P6\n%d %d\n255\n", width, height);
+
+    for (int py = 0 ; py < height ; py++) {
+        int y = py / PPM_SCALE;
+        int line = (y - 1) / PPM_CELL_H, row = (y - 1) % PPM_CELL_H;
+        for (int px = 0 ; px < width ; px++) {
+            int x = px / PPM_SCALE;
+            int column = (x - 1) / PPM_CELL_W, pixel = (x - 1) % PPM_CELL_W;
+            const uint8_t *color = background;
+            if (y >= 1 && x >= 1 && line < LCDEMU_LINES && column < LCDEMU_COLUMNS && row < 8 && pixel < 5) {
+                uint8_t glyph[5];
+                Glyph(LcdEmu_Char(column, line), glyph);
+                color = displayOn && (glyph[pixel] & (1 << row)) ? pixelOn : pixelOff;
+            }
+            fwrite(color, 1, 3, f);
+        }
+    }
+    fclose(f);
+}
+
+void LcdEmu_BeginFrame(void)
+{
+    uint32_t index = frame.index;
+    memset(&frame, 0, sizeof(frame));
+    frame.index = index;
+    frame.start_ns = Host_Nanos();
+}
+
+LcdEmuFrame LcdEmu_EndFrame(void)
+{
+    frame.elapsed_ns = Host_Nanos() - frame.start_ns;
+    LcdEmuFrame done = frame;
+
+    if (captureText != NULL) {
+        fprintf(captureText, "# frame %u t=%.3fms elapsed=%.1fus busy=%.1fus commands=%u data=%u late=%u\n",
+                (unsigned) done.index, done.start_ns / 1e6, done.elapsed_ns / 1e3, done.busy_ns / 1e3,
+                (unsigned) done.commands, (unsigned) done.data, (unsigned) done.late);
+        for (uint8_t y = 0 ; y < LCDEMU_LINES ; y++) {
+            char line[LCDEMU_COLUMNS + 1];
+            LcdEmu_Line(y, line);
+            for (uint8_t x = 0 ; x < LCDEMU_COLUMNS ; x++)
+                if (!displayOn || line[x] < 0x20 || line[x] > 0x7E)
+                    line[x] = displayOn ? '?' : ' ';
+            fprintf(captureText, "|%s|\n", line);
+        }
+        if (capturePpm)
+            WritePpm(done.index);
+    }
+
+    frame.index++;
+    LcdEmu_BeginFrame();
+    return done;
+}
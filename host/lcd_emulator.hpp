@@ -0,0 +1,51 @@
+//-------------------------------------------------------------------------------------------------
+// HD44780 emulator
+// Model of the controller driven by hd44780/HD44780.cpp : 4-bit nibble protocol, DDRAM and
+// CGRAM addressing, entry mode, display shift, clear and home, with the execution time of every
+// instruction. Frames can be captured as text and PPM images, with the simulated time they cost.
+//-------------------------------------------------------------------------------------------------
+
+#ifndef _lcd_emulator_
+#define _lcd_emulator_
+
+#include <stdint.h>
+
+#define LCDEMU_COLUMNS 16 // visible characters per line
+#define LCDEMU_LINES 2
+#define LCDEMU_LINE_LENGTH 40 // characters of DDRAM per line
+
+//-------------------------------------------------------------------------------------------------
+//
+// Statistics of a frame
+//
+//-------------------------------------------------------------------------------------------------
+
+struct LcdEmuFrame {
+    uint32_t index;         // number of the frame
+    uint64_t start_ns;      // simulated time at the beginning of the frame
+    uint64_t elapsed_ns;    // simulated time spent by the driver during the frame
+    uint64_t busy_ns;       // time the controller spent executing the frame's instructions
+    uint32_t commands;      // instructions received during the frame
+    uint32_t data;          // data bytes received during the frame
+    uint32_t late;          // bytes received while the controller was still busy
+};
+
+//-------------------------------------------------------------------------------------------------
+//
+// Function declarations
+//
+//-------------------------------------------------------------------------------------------------
+
+void LcdEmu_Reset(void);                            // power-on state : 8-bit interface, display off
+void LcdEmu_Strobe(bool rs, uint8_t nibble);        // falling edge of E with DB7..DB4 = nibble
+void LcdEmu_AttachParallel(void);                   // listens to the pins wired in HD44780.hpp
+void LcdEmu_AttachI2c(uint8_t address);             // PCF8574 expander on the TWI bus, as with LCD_I2C
+char LcdEmu_Char(uint8_t x, uint8_t y);             // character code visible at (x, y)
+void LcdEmu_Line(uint8_t y, char *line);            // visible line, LCDEMU_COLUMNS characters + '\0'
+uint8_t LcdEmu_Shift(void);                         // current display shift, in characters
+bool LcdEmu_DisplayOn(void);
+void LcdEmu_Capture(const char *directory, bool ppm); // writes every frame to the directory
+void LcdEmu_BeginFrame(void);
+LcdEmuFrame LcdEmu_EndFrame(void);                  // closes the frame, captures it if enabled
+
+#endif
@@ -0,0 +1,448 @@
+//-------------------------------------------------------------------------------------------------
+// Terminal front end
+// Runs the firmware of main.cpp on Linux, in a terminal : the LCD emulator and the diodes of
+// PORTB are drawn with ANSI escape sequences, the keyboard drives the buttons and the
+// potentiometer, and the USART is connected to a console line and a log of the messages.
+//
+// The screen is kept as a grid of cells. A frame only sends the cells which changed since the
+// previous one, as a cursor move followed by the characters, in a single write : a game step
+// costs a few dozen bytes, so thousands of frames per second fit through an SSH session without
+// redrawing, hence without flicker. A frame is drawn once the LCD has not changed for a poll
+// period, so the half-written lines of the driver are never shown.
+//
+// The firmware's main is renamed Firmware_Main when it is built for the front end (see the
+// readme), and runs once the terminal is set up.
+//
+// Usage: dino [-a adc] [-H hold_ms] [-f] [-t trace.json]
+//   -a adc      - initial value of the potentiometer, 0 to 1023 (default 512)
+//   -H hold_ms  - simulated time a key press holds its button down (default 250)
+//   -f          - run as fast as possible instead of in real time, e.g. to profile the firmware
+//   -t file     - write the phases and the events of the game as a Chrome trace (built with PROBES)
+//
+// Keys : 1 to 4 or up/down/space press B1 to B4, left/right turn the potentiometer, ':' types a
+// console command sent over the USART on Enter, q quits.
+//-------------------------------------------------------------------------------------------------
+
+#undef main // the firmware's main is Firmware_Main
+
+#include "host.hpp"
+#include "lcd_emulator.hpp"
+#include "trace.hpp"
+#include "../hd44780/HD44780.hpp"
+#include <avr/io.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+int Firmware_Main(void);
+
+// Screen
+#define TERM_ROWS 18
+#define TERM_COLUMNS 64
+#define TERM_LOG_LINES 8            // last USART messages shown
+#define TERM_LOG_ROW 7              // row of the oldest one
+#define TERM_POLL_NS 1000000        // period of the keyboard reads and of the frames, in simulated time
+#define TERM_READ_NS 10000          // simulated time of a read of the buttons, so the waiting loops let time run
+#define TERM_POT_STEP 32            // ADC steps of a turn of the potentiometer
+#define TERM_OUTPUT_SIZE 16384
+
+// Buttons on PIND0..3, pulled low when pressed
+#define TERM_BUTTONS 4
+
+enum Attribute { PLAIN, LCD, LED_ON, LED_OFF, DIM };
+
+// Escape sequences selecting the attributes
+static const char *const ATTRIBUTES[] = { "\x1b[0m", "\x1b[0;30;42m", "\x1b[0;1;31m", "\x1b[0;2;31m", "\x1b[0;2m" };
+
+struct Cell {
+    char c;
+    uint8_t attribute;
+};
+
+static Cell screen[TERM_ROWS][TERM_COLUMNS]; // frame being composed
+static Cell shown[TERM_ROWS][TERM_COLUMNS];  // frame on the terminal
+
+static char output[TERM_OUTPUT_SIZE];
+static size_t outputLength = 0;
+
+// Statistics
+static uint64_t frames = 0, bytesWritten = 0;
+
+// Keyboard
+static termios savedTermios;
+static bool rawMode = false;
+static uint64_t releaseAt[TERM_BUTTONS]; // simulated time at which a pressed button is released
+static uint8_t pressed = 0;
+static uint64_t holdNs = 250000000;
+static char escape[8];          // escape sequence being received
+static uint8_t escapeLength = 0;
+
+// Console line typed after ':', and USART messages
+static bool typing = false;
+static char command[TERM_COLUMNS];
+static uint8_t commandLength = 0;
+static char logLines[TERM_LOG_LINES][TERM_COLUMNS + 1];
+static uint8_t logNext = 0;
+static char received[TERM_COLUMNS + 1];
+static uint8_t receivedLength = 0;
+
+// LCD and diodes as seen at the previous poll
+static char lastLcd[LCDEMU_LINES * LCDEMU_COLUMNS + 2];
+
+//-------------------------------------------------------------------------------------------------
+//
+// Output
+//
+//-------------------------------------------------------------------------------------------------
+
+static void Emit(const char *s, size_t length)
+{
+    if (outputLength + length > sizeof(output))
+        return;
+    memcpy(output + outputLength, s, length);
+    outputLength += length;
+}
+
+static void EmitString(const char *s)
+{
+    Emit(s, strlen(s));
+}
+
+static void Flush(void)
+{
+    size_t done = 0;
+    while (done < outputLength) {
+        ssize_t n = write(STDOUT_FILENO, output + done, outputLength - done);
+        if (n < 0 && errno != EINTR)
+            break;
+        if (n > 0)
+            done += n;
+    }
+    bytesWritten += outputLength;
+    outputLength = 0;
+}
+
+static void Put(uint8_t row, uint8_t column, const char *s, uint8_t attribute)
+{
+    for ( ; *s && column < TERM_COLUMNS ; s++, column++) {
+        screen[row][column].c = *s;
+        screen[row][column].attribute = attribute;
+    }
+}
+
+/**
+ * Sends the cells which changed since the previous frame. Neighbouring cells are sent without a
+ * cursor move between them, and the attribute is only sent when it changes.
+ */
+static void DrawFrame(void)
+{
+    int cursorRow = -1, cursorColumn = -1, attribute = -1;
+    char move[16];
+
+    for (int row = 0 ; row < TERM_ROWS ; row++) {
+        for (int column = 0 ; column < TERM_COLUMNS ; column++) {
+            Cell cell = screen[row][column];
+            if (cell.c == shown[row][column].c && cell.attribute == shown[row][column].attribute)
+                continue;
+            if (row != cursorRow || column != cursorColumn)
+                Emit(move, snprintf(move, sizeof(move), "\x1b[%d;%dH", row + 1, column + 1));
+            if (cell.attribute != attribute)
+                EmitString(ATTRIBUTES[cell.attribute]);
+            Emit(&cell.c, 1);
+            shown[row][column] = cell;
+            cursorRow = row;
+            cursorColumn = column + 1;
+            attribute = cell.attribute;
+        }
+    }
+
+    if (outputLength > 0) {
+        frames++;
+        Flush();
+    }
+}
+
+/**
+ * Composes the whole screen : the LCD and its frame, the diodes, the potentiometer, the console
+ * line and the last USART messages.
+ */
+static void Compose(void)
+{
+    char text[TERM_COLUMNS + 1];
+
+    for (int row = 0 ; row < TERM_ROWS ; row++)
+        for (int column = 0 ; column < TERM_COLUMNS ; column++)
+            screen[row][column] = Cell{ ' ', PLAIN };
+
+    Put(0, 0, "+----------------+", DIM);
+    Put(3, 0, "+----------------+", DIM);
+    for (uint8_t y = 0 ; y < LCDEMU_LINES ; y++) {
+        Put(1 + y, 0, "|", DIM);
+        Put(1 + y, LCDEMU_COLUMNS + 1, "|", DIM);
+        for (uint8_t x = 0 ; x < LCDEMU_COLUMNS ; x++) {
+            char c = LcdEmu_DisplayOn() ? LcdEmu_Char(x, y) : ' ';
+            screen[1 + y][1 + x] = Cell{ (char) (c >= 0x20 && c <= 0x7E ? c : '?'), LCD };
+        }
+    }
+
+    // LED1 to LED4 are PORTB5 to PORTB2, lit when low
+    for (uint8_t led = 0 ; led < 4 ; led++) {
+        bool on = !(PORTB.value & (1 << (5 - led)));
+        snprintf(text, sizeof(text), "LED%d", led + 1);
+        Put(1, 21 + 6 * led, text, DIM);
+        Put(2, 21 + 6 * led, on ? "(##)" : "(  )", on ? LED_ON : LED_OFF);
+    }
+
+    snprintf(text, sizeof(text), "pot %4u   B1-4 %c%c%c%c", (unsigned) ADC.value, pressed & 1 ? '*' : '.',
+             pressed & 2 ? '*' : '.', pressed & 4 ? '*' : '.', pressed & 8 ? '*' : '.');
+    Put(3, 21, text, PLAIN);
+    Put(4, 0, "1-4/up/down/space: B1-4  left/right: pot  ':' command  q: quit", DIM);
+
+    if (typing) {
+        Put(5, 0, "> ", PLAIN);
+        Put(5, 2, command, PLAIN);
+        Put(5, 2 + commandLength, "_", PLAIN);
+    }
+
+    for (uint8_t i = 0 ; i < TERM_LOG_LINES ; i++)
+        Put(TERM_LOG_ROW + i, 0, logLines[(logNext + i) % TERM_LOG_LINES], PLAIN);
+
+    snprintf(text, sizeof(text), "t %llu s", (unsigned long long) (Host_Nanos() / 1000000000));
+    Put(TERM_ROWS - 1, 0, text, DIM);
+}
+
+//-------------------------------------------------------------------------------------------------
+//
+// USART
+//
+//-------------------------------------------------------------------------------------------------
+
+static void OnTransmit(uint8_t value, uint8_t old)
+{
+    if (value == '\n') {
+        received[receivedLength] = '\0';
+        memcpy(logLines[logNext], received, receivedLength + 1);
+        logNext = (logNext + 1) % TERM_LOG_LINES;
+        receivedLength = 0;
+    } else if (value >= 0x20 && value <= 0x7E && receivedLength < TERM_COLUMNS) {
+        received[receivedLength++] = value; // the '\r' and the '\0' sent by USART_Transmit_String are dropped
+    }
+}
+
+//-------------------------------------------------------------------------------------------------
+//
+// Keyboard
+//
+//-------------------------------------------------------------------------------------------------
+
+static void RestoreTerminal(void)
+{
+    if (!rawMode)
+        return;
+    EmitString("\x1b[0m\x1b[?25h");
+    char move[16];
+    Emit(move, snprintf(move, sizeof(move), "\x1b[%d;1H\n", TERM_ROWS));
+    Flush();
+    tcsetattr(STDIN_FILENO, TCSANOW, &savedTermios);
+    rawMode = false;
+}
+
+static void OnSignal(int signal)
+{
+    RestoreTerminal();
+    _exit(128 + signal);
+}
+
+static void Quit(void)
+{
+    RestoreTerminal();
+    Trace_Close();
+    double seconds = Host_Nanos() / 1e9;
+    fprintf(stderr, "simulated_s=%.3f frames=%llu bytes_per_frame=%.1f markers=%llu\n", seconds,
+            (unsigned long long) frames, frames ? (double) bytesWritten / frames : 0.0,
+            (unsigned long long) Trace_Count());
+}
+
+static void Press(uint8_t button)
+{
+    // The edge is seen by the pin change interrupt ; the repeats of a held key keep the button down
+    if (!(pressed & (1 << button)))
+        Host_PinChange(1 << button);
+    pressed |= (1 << button);
+    releaseAt[button] = Host_Nanos() + holdNs;
+}
+
+static void TurnPotentiometer(int steps)
+{
+    int value = (int) ADC.value + steps;
+    ADC.value = value < 0 ? 0 : value > 1023 ? 1023 : value;
+}
+
+static void TypeCommand(char c)
+{
+    if (c == '\r' || c == '\n') {
+        for (uint8_t i = 0 ; i < commandLength ; i++)
+            Host_UartReceive(command[i]);
+        Host_UartReceive('\r');
+        typing = false;
+    } else if (c == 0x1B) {
+        typing = false;
+    } else if (c == 0x7F || c == '\b') {
+        if (commandLength > 0)
+            commandLength--;
+    } else if (c >= 0x20 && c <= 0x7E && commandLength < TERM_COLUMNS - 4) {
+        command[commandLength++] = c;
+    }
+    command[commandLength] = '\0';
+}
+
+static void HandleKey(char c)
+{
+    if (typing) {
+        TypeCommand(c);
+        return;
+    }
+
+    // Arrows : ESC [ A to ESC [ D
+    if (escapeLength > 0 || c == 0x1B) {
+        escape[escapeLength++] = c;
+        if (escapeLength == 3) {
+            switch (escape[2]) {
+                case 'A': Press(1); break;
+                case 'B': Press(2); break;
+                case 'C': TurnPotentiometer(TERM_POT_STEP); break;
+                case 'D': TurnPotentiometer(-TERM_POT_STEP); break;
+            }
+        }
+        if (escapeLength == 3 || (escapeLength == 2 && c != '['))
+            escapeLength = 0;
+        return;
+    }
+
+    switch (c) {
+        case '1': case '2': case '3': case '4': Press(c - '1'); break;
+        case ' ': case '\r': case '\n': Press(3); break;
+        case '+': TurnPotentiometer(TERM_POT_STEP); break;
+        case '-': TurnPotentiometer(-TERM_POT_STEP); break;
+        case ':':
+            typing = true;
+            commandLength = 0;
+            command[0] = '\0';
+            break;
+        case 'q':
+            exit(0);
+    }
+}
+
+/**
+ * Called by the host runtime every TERM_POLL_NS of simulated time : reads the keys, releases the
+ * buttons held long enough, and draws a frame once the LCD is settled.
+ */
+static void Poll(void)
+{
+    char keys[64];
+    ssize_t n;
+    while ((n = read(STDIN_FILENO, keys, sizeof(keys))) > 0)
+        for (ssize_t i = 0 ; i < n ; i++)
+            HandleKey(keys[i]);
+
+    for (uint8_t b = 0 ; b < TERM_BUTTONS ; b++) {
+        if ((pressed & (1 << b)) && Host_Nanos() >= releaseAt[b]) {
+            pressed &= ~(1 << b);
+            Host_PinChange(1 << b);
+        }
+    }
+
+    // Only draw what the LCD showed for a whole poll period
+    char lcd[sizeof(lastLcd)];
+    for (uint8_t y = 0 ; y < LCDEMU_LINES ; y++)
+        for (uint8_t x = 0 ; x < LCDEMU_COLUMNS ; x++)
+            lcd[y * LCDEMU_COLUMNS + x] = LcdEmu_Char(x, y);
+    lcd[LCDEMU_LINES * LCDEMU_COLUMNS] = LcdEmu_DisplayOn();
+    lcd[LCDEMU_LINES * LCDEMU_COLUMNS + 1] = '\0';
+    bool settled = memcmp(lcd, lastLcd, sizeof(lcd)) == 0;
+    memcpy(lastLcd, lcd, sizeof(lcd));
+    if (!settled)
+        return;
+
+    Compose();
+    DrawFrame();
+}
+
+/**
+ * Reading the buttons takes some time, so that the loops waiting for a button let the
+ * interrupts, the keyboard and the frames run.
+ */
+static uint8_t ReadButtons(uint8_t value)
+{
+    Host_Delay(TERM_READ_NS);
+    return (value & ~((1 << TERM_BUTTONS) - 1)) | (~pressed & ((1 << TERM_BUTTONS) - 1));
+}
+
+int main(int argc, char **argv)
+{
+    int adc = 512;
+    bool fast = false;
+    const char *trace = NULL;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "a:H:ft:")) != -1) {
+        switch (opt) {
+            case 'a': adc = atoi(optarg); break;
+            case 'H': holdNs = strtoull(optarg, NULL, 10) * 1000000; break;
+            case 'f': fast = true; break;
+            case 't': trace = optarg; break;
+            default:
+                fprintf(stderr, "usage: %s [-a adc] [-H hold_ms] [-f] [-t trace.json]\n", argv[0]);
+                return 2;
+        }
+    }
+    if (!isatty(STDIN_FILENO)) {
+        fprintf(stderr, "%s: the standard input must be a terminal\n", argv[0]);
+        return 2;
+    }
+    if (trace != NULL && !Trace_Open(trace)) {
+        perror(trace);
+        return 2;
+    }
+
+    // Keys are read one by one, without echo nor waiting ; Ctrl-C still interrupts
+    tcgetattr(STDIN_FILENO, &savedTermios);
+    termios raw = savedTermios;
+    raw.c_lflag &= ~(ICANON | ECHO);
+    raw.c_cc[VMIN] = 0;
+    raw.c_cc[VTIME] = 0;
+    tcsetattr(STDIN_FILENO, TCSANOW, &raw);
+    rawMode = true;
+    atexit(Quit);
+    signal(SIGINT, OnSignal);
+    signal(SIGTERM, OnSignal);
+
+    EmitString("\x1b[0m\x1b[2J\x1b[?25l");
+    Flush();
+    for (int row = 0 ; row < TERM_ROWS ; row++)
+        for (int column = 0 ; column < TERM_COLUMNS ; column++)
+            shown[row][column] = Cell{ ' ', PLAIN };
+
+#ifdef LCD_I2C
+    LcdEmu_AttachI2c(LCD_I2C_ADDRESS);
+#else
+    LcdEmu_AttachParallel();
+#endif
+    PIND.onRead = ReadButtons;
+    UDR0.onWrite = OnTransmit;
+    ADC.value = adc < 0 ? 0 : adc > 1023 ? 1023 : adc;
+    Host_Poll(Poll, TERM_POLL_NS);
+    Host_RealTime(!fast);
+
+    int status = Firmware_Main();
+
+    // Show the last screen of the firmware
+    Host_Delay(2 * TERM_POLL_NS);
+    return status;
+}
@@ -0,0 +1,145 @@
+#include "trace.hpp"
+#include "host.hpp"
+#include "../probe/probe.hpp"
+#include <stdio.h>
+#include <string.h>
+
+#define TRACE_RECORDS 8192      // markers kept before they are written
+#define TRACE_OUTPUT 65536      // bytes of JSON formatted before a write
+#define TRACE_EVENT_MAX 128     // bytes of JSON of a marker, at most
+
+/**
+ * Marker recorded by Probe_Record, as written to GPIOR0 on the board.
+ */
+struct TraceRecord {
+    uint64_t ns;
+    uint8_t marker;
+};
+
+static const char *const NAMES[PROBE_COUNT] = PROBE_NAMES;
+
+static FILE *traceFile = NULL;
+static TraceRecord records[TRACE_RECORDS];
+static uint32_t recordCount = 0;
+static uint64_t recordTotal = 0;
+static char output[TRACE_OUTPUT];
+
+//-------------------------------------------------------------------------------------------------
+//
+// JSON
+//
+//-------------------------------------------------------------------------------------------------
+
+static char *AppendString(char *out, const char *s)
+{
+    size_t length = strlen(s);
+    memcpy(out, s, length);
+    return out + length;
+}
+
+static char *AppendUnsigned(char *out, uint64_t value)
+{
+    char digits[20];
+    int count = 0;
+    do {
+        digits[count++] = '0' + value % 10;
+        value /= 10;
+    } while (value != 0);
+    while (count > 0)
+        *out++ = digits[--count];
+    return out;
+}
+
+/**
+ * Timestamp in microseconds, the unit of the trace format, with the nanoseconds as decimals.
+ */
+static char *AppendTimestamp(char *out, uint64_t ns)
+{
+    out = AppendUnsigned(out, ns / 1000);
+    uint32_t decimals = ns % 1000;
+    *out++ = '.';
+    *out++ = '0' + decimals / 100;
+    *out++ = '0' + decimals / 10 % 10;
+    *out++ = '0' + decimals % 10;
+    return out;
+}
+
+/**
+ * Turns the markers recorded into trace events : a phase begins ("B") or ends ("E") on the
+ * timeline of the firmware, an event is an instant ("i") of it.
+ */
+static void WriteRecords(void)
+{
+    char *out = output;
+    for (uint32_t i = 0 ; i < recordCount ; i++) {
+        uint8_t marker = records[i].marker;
+        uint8_t id = marker & ~(PROBE_END_FLAG | PROBE_EVENT_FLAG);
+        if (id == 0 || id >= PROBE_COUNT)
+            continue;
+
+        out = AppendString(out, ",\n{\"name\":\"");
+        out = AppendString(out, NAMES[id]);
+        if (marker & PROBE_EVENT_FLAG)
+            out = AppendString(out, "\",\"ph\":\"i\",\"s\":\"t\",\"ts\":");
+        else if (marker & PROBE_END_FLAG)
+            out = AppendString(out, "\",\"ph\":\"E\",\"ts\":");
+        else
+            out = AppendString(out, "\",\"ph\":\"B\",\"ts\":");
+        out = AppendTimestamp(out, records[i].ns);
+        out = AppendString(out, ",\"pid\":1,\"tid\":1}");
+
+        if (out - output > TRACE_OUTPUT - TRACE_EVENT_MAX) {
+            fwrite(output, 1, out - output, traceFile);
+            out = output;
+        }
+    }
+    fwrite(output, 1, out - output, traceFile);
+    recordCount = 0;
+}
+
+//-------------------------------------------------------------------------------------------------
+//
+// Recording
+//
+//-------------------------------------------------------------------------------------------------
+
+void Probe_Record(uint8_t marker)
+{
+    if (traceFile == NULL)
+        return;
+    records[recordCount].ns = Host_Nanos();
+    records[recordCount].marker = marker;
+    recordTotal++;
+    if (++recordCount == TRACE_RECORDS)
+        WriteRecords();
+}
+
+bool Trace_Open(const char *path)
+{
+    Trace_Close();
+    traceFile = fopen(path, "w");
+    if (traceFile == NULL)
+        return false;
+    recordCount = 0;
+    recordTotal = 0;
+    fputs("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n"
+          "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"dino\"}},\n"
+          "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"firmware\"}}",
+          traceFile);
+    return true;
+}
+
+void Trace_Close(void)
+{
+    if (traceFile == NULL)
+        return;
+    WriteRecords();
+    fputs("\n]}\n", traceFile);
+    fclose(traceFile);
+    traceFile = NULL;
+}
+
+uint64_t Trace_Count(void)
+{
+    return recordTotal;
+}
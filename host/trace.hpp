@@ -0,0 +1,26 @@
+//-------------------------------------------------------------------------------------------------
+// Timeline trace
+// Writes the markers of probe/probe.hpp, when the firmware is built for the host with PROBES
+// defined, as a Chrome trace (JSON) which chrome://tracing and ui.perfetto.dev open : every
+// phase is a span on the simulated time, and every event of the game an instant.
+//
+// Probe_Record only stores the marker and the simulated time in a buffer ; the buffer is turned
+// into JSON and written once it is full, so tracing costs a few percent of the run time.
+//-------------------------------------------------------------------------------------------------
+
+#ifndef _trace_
+#define _trace_
+
+#include <stdint.h>
+
+//-------------------------------------------------------------------------------------------------
+//
+// Function declarations
+//
+//-------------------------------------------------------------------------------------------------
+
+bool Trace_Open(const char *path);      // starts recording the markers to a file, false if it can not be created
+void Trace_Close(void);                 // writes the markers left and closes the file
+uint64_t Trace_Count(void);             // markers recorded since Trace_Open
+
+#endif
@@ -0,0 +1,26 @@
+//-------------------------------------------------------------------------------------------------
+// Host stand-in for <util/atomic.h>
+// Interrupt handlers only run from the host runtime, between two statements of the firmware, so
+// an atomic block only has to keep them from running while it executes.
+//-------------------------------------------------------------------------------------------------
+
+#ifndef _host_util_atomic_
+#define _host_util_atomic_
+
+#include <avr/interrupt.h>
+
+#define ATOMIC_RESTORESTATE 0
+#define ATOMIC_FORCEON 1
+
+static inline uint8_t _host_atomic_enter(void)
+{
+    uint8_t previous = Host_InterruptsEnabled;
+    Host_InterruptsEnabled = 0;
+    return previous;
+}
+
+#define ATOMIC_BLOCK(type) \
+    for (uint8_t _host_sreg = _host_atomic_enter(), _host_once = 1 ; _host_once ; \
+         Host_InterruptsEnabled = (type) ? 1 : _host_sreg, _host_once = 0)
+
+#endif
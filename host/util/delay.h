@@ -0,0 +1,21 @@
+//-------------------------------------------------------------------------------------------------
+// Host stand-in for <util/delay.h>
+// The delays do not spin : they advance the simulated clock of the host runtime.
+//-------------------------------------------------------------------------------------------------
+
+#ifndef _host_util_delay_
+#define _host_util_delay_
+
+#include "../host.hpp"
+
+static inline void _delay_us(double us)
+{
+    Host_Delay((uint64_t) (us * 1000.0));
+}
+
+static inline void _delay_ms(double ms)
+{
+    Host_Delay((uint64_t) (ms * 1000000.0));
+}
+
+#endif
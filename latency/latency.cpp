@@ -0,0 +1,156 @@
+#include "latency.hpp"
+#include "../clock/clock.hpp"
+#include <avr/interrupt.h>
+#include <util/atomic.h>
+#include <string.h>
+
+#define LATENCY_BUTTONS 4 // PIND0..PIND3
+
+struct Histogram {
+    uint16_t count;
+    uint32_t min, max;
+    uint16_t buckets[LATENCY_BUCKETS];
+};
+
+static Histogram histograms[LATENCY_LEVELS];
+
+static volatile uint32_t pressTime[LATENCY_BUTTONS]; // timestamp of the last unhandled press of each button
+static volatile uint8_t pressPending = 0; // buttons with an unhandled press
+static uint8_t lastPins = 0xFF; // buttons' pins on the previous pin change
+
+static volatile bool measuring = false; // a press was taken by Latency_Begin
+static volatile uint32_t measureStart;
+static volatile uint8_t measureLevel;
+
+/**
+ * Bucket of a latency : the units below 4 have their own bucket, then every power of 2 is split in 2 buckets.
+ */
+static uint8_t Bucket(uint32_t us)
+{
+    uint32_t units = us >> LATENCY_UNIT_SHIFT;
+    if (units < 4)
+        return units;
+    uint8_t octave = 2; // highest bit set in units
+    while (octave < 31 && (units >> (octave + 1)) != 0)
+        octave++;
+    uint8_t bucket = 4 + (octave - 2) * 2 + ((units >> (octave - 1)) & 1);
+    return bucket < LATENCY_BUCKETS ? bucket : LATENCY_BUCKETS - 1;
+}
+
+/**
+ * Highest latency of a bucket, in us.
+ */
+static uint32_t BucketTop(uint8_t bucket)
+{
+    uint32_t top;
+    if (bucket < 4) {
+        top = bucket + 1;
+    } else {
+        uint8_t octave = 2 + (bucket - 4) / 2;
+        top = (uint32_t) (2 + (bucket - 4) % 2 + 1) << (octave - 1);
+    }
+    return (top << LATENCY_UNIT_SHIFT) - 1;
+}
+
+void Latency_Init(void)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        lastPins = PIND;
+        pressPending = 0;
+        measuring = false;
+        PCMSK2 |= (1 << PCINT16) | (1 << PCINT17) | (1 << PCINT18) | (1 << PCINT19);
+        PCIFR = (1 << PCIE2);
+        PCICR |= (1 << PCIE2);
+    }
+}
+
+void Latency_Discard(void)
+{
+    pressPending = 0;
+}
+
+bool Latency_Begin(uint8_t button, uint8_t level)
+{
+    bool pending = false;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        if (pressPending & (1 << button)) {
+            pressPending &= ~(1 << button);
+            measureStart = pressTime[button];
+            measureLevel = level;
+            measuring = level >= 1 && level <= LATENCY_LEVELS;
+            pending = measuring;
+        }
+    }
+    return pending;
+}
+
+void Latency_End(void)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        if (measuring) {
+            measuring = false;
+            uint32_t us = Clock_Micros() - measureStart;
+            Histogram *h = &histograms[measureLevel - 1];
+            if (h->count == 0 || us < h->min)
+                h->min = us;
+            if (us > h->max)
+                h->max = us;
+            if (h->count < UINT16_MAX) {
+                h->count++;
+                h->buckets[Bucket(us)]++;
+            }
+        }
+    }
+}
+
+void Latency_Get(uint8_t level, LatencyStats *stats)
+{
+    Histogram h;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        h = histograms[level - 1];
+    }
+
+    stats->count = h.count;
+    stats->min = h.min;
+    stats->max = h.max;
+    stats->p50 = stats->p99 = 0;
+
+    // The percentiles are the tops of the buckets reaching 50 % and 99 % of the latencies, at most the maximum
+    uint16_t seen = 0;
+    uint16_t rank50 = (h.count + 1) / 2, rank99 = h.count - h.count / 100;
+    for (uint8_t i = 0; i < LATENCY_BUCKETS && h.count > 0; i++) {
+        seen += h.buckets[i];
+        if (stats->p50 == 0 && seen >= rank50)
+            stats->p50 = BucketTop(i) < h.max ? BucketTop(i) : h.max;
+        if (seen >= rank99) {
+            stats->p99 = BucketTop(i) < h.max ? BucketTop(i) : h.max;
+            break;
+        }
+    }
+}
+
+void Latency_Reset(void)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        memset(histograms, 0, sizeof(histograms));
+    }
+}
+
+ISR(PCINT2_vect)
+{
+    uint8_t pins = PIND;
+    // The buttons pull their pin low when pressed : a press is a falling edge
+    uint8_t pressed = lastPins & ~pins & ((1 << LATENCY_BUTTONS) - 1);
+    lastPins = pins;
+
+    if (pressed == 0)
+        return;
+    uint32_t now = Clock_Micros();
+    for (uint8_t b = 0; b < LATENCY_BUTTONS; b++) {
+        // Only the first press is kept until it is handled, the next ones being bounces or repeats
+        if ((pressed & (1 << b)) && !(pressPending & (1 << b))) {
+            pressTime[b] = now;
+            pressPending |= (1 << b);
+        }
+    }
+}
@@ -0,0 +1,79 @@
+/**
+ * File: latency.hpp
+ * -----------------
+ * Measures the responsiveness of the game : the time from the press of a button to the LCD write showing the
+ * response, kept as one histogram per difficulty level.
+ *
+ * The presses are timestamped by the pin change interrupt of the buttons, with the clock of clock.hpp. When the game
+ * handles a press, Latency_Begin takes its timestamp ; the game then marks the last LCD byte of its response (see
+ * LCD_Mark), and Latency_End records the latency when the byte is sent to the display.
+ *
+ * The histograms have 2 buckets per power of 2 of LATENCY_UNIT_US, so the percentiles are known to 50 % at worst ; the
+ * minimum and the maximum are exact.
+ */
+
+#ifndef _latency_
+#define _latency_
+
+#include <stdint.h>
+
+#define LATENCY_LEVELS 4        // difficulty levels, 1 to LATENCY_LEVELS
+#define LATENCY_BUCKETS 24      // the last bucket holds every latency above 3 * 2^11 units (1.5 s)
+#define LATENCY_UNIT_SHIFT 8    // a unit of the buckets is 2^LATENCY_UNIT_SHIFT us (256 us)
+
+/**
+ * Struct: LatencyStats
+ * Summary of the histogram of a difficulty level, in us.
+ * @public count - number of latencies recorded
+ * @public min, max - lowest and highest latency recorded
+ * @public p50, p99 - upper bounds of the median and of the 99th percentile
+ */
+struct LatencyStats {
+    uint16_t count;
+    uint32_t min, max, p50, p99;
+};
+
+/**
+ * Function: Latency_Init
+ * Starts timestamping the presses of the buttons B1..B4 (PIND0..PIND3), with the pin change interrupt PCINT2.
+ * The clock must be started.
+ */
+void Latency_Init(void);
+
+/**
+ * Function: Latency_Discard
+ * Forgets the presses which have not been handled, such as the ones made on the other screens.
+ */
+void Latency_Discard(void);
+
+/**
+ * Function: Latency_Begin(uint8_t, uint8_t)
+ * Takes the timestamp of the last unhandled press of a button, to be measured by the next Latency_End.
+ * @param button - button handled : B1..B4 (PIND0..PIND3)
+ * @param level - difficulty level whose histogram records the latency
+ * @return bool - whether there was a press to measure ; a button held since a previous measure has none
+ */
+bool Latency_Begin(uint8_t button, uint8_t level);
+
+/**
+ * Function: Latency_End
+ * Records the latency of the press taken by Latency_Begin, if any. Meant to be the LCD mark hook : it may be called
+ * from an interrupt.
+ */
+void Latency_End(void);
+
+/**
+ * Function: Latency_Get(uint8_t, LatencyStats*)
+ * Summarizes the histogram of a difficulty level.
+ * @param level - difficulty level, 1 to LATENCY_LEVELS
+ * @param stats - receives the summary
+ */
+void Latency_Get(uint8_t level, LatencyStats *stats);
+
+/**
+ * Function: Latency_Reset
+ * Empties the histograms of every difficulty level.
+ */
+void Latency_Reset(void);
+
+#endif
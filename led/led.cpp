@@ -0,0 +1,104 @@
+#include "led.hpp"
+#include <avr/interrupt.h>
+#include <util/atomic.h>
+
+// Timer2 in CTC mode, prescaler 64 : one compare interrupt every 250 timer cycles, i.e. every 1 ms at 16 MHz
+#define LED_TIMER_TOP (F_CPU / 64 / 1000 - 1)
+
+static volatile uint8_t ledMask = 0; // diodes to turn on
+static volatile uint8_t ledBlinkMask = 0; // diodes following the blink pattern
+static volatile uint8_t ledPattern = 0xFF; // blink pattern, bit 0 being the current period
+static volatile uint8_t ledLevel = LED_BRIGHTNESS_MAX; // brightness of the diodes
+static uint8_t ledPhase = 0; // PWM step of the current interrupt
+static uint8_t ledTicks = 0; // interrupts since the beginning of the current blink period
+
+/**
+ * Writes the diodes to PORTB in a single masked write. The diodes are lit when their pin is low.
+ * Must be called with the interrupts disabled, as the LCD driver shares PORTB.
+ */
+static inline void WriteLEDs(uint8_t mask)
+{
+    PORTB = (PORTB & ~LED_PORT_MASK) | (~(mask << LED4) & LED_PORT_MASK);
+}
+
+/**
+ * Starts the Timer2 interrupt if the brightness or blinking need it, stops it otherwise.
+ * Must be called with the interrupts disabled.
+ */
+static void UpdateTimer(void)
+{
+    if (ledLevel < LED_BRIGHTNESS_MAX || ledBlinkMask != 0) {
+        if (!(TIMSK2 & (1 << OCIE2A))) {
+            TCNT2 = 0;
+            ledPhase = 0;
+            ledTicks = 0;
+            TIMSK2 |= (1 << OCIE2A);
+        }
+    } else {
+        TIMSK2 &= ~(1 << OCIE2A);
+        WriteLEDs(ledMask);
+    }
+}
+
+void LED_Init(void)
+{
+    DDRB |= LED_PORT_MASK;
+
+    OCR2A = LED_TIMER_TOP;
+    TCCR2A = (1 << WGM21); // CTC mode
+    TCCR2B = (1 << CS22); // prescaler 64
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        ledMask = 0;
+        ledBlinkMask = 0;
+        ledLevel = LED_BRIGHTNESS_MAX;
+        UpdateTimer();
+    }
+}
+
+void LED_Set(uint8_t mask)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        ledMask = mask;
+        // While the timer runs, the interrupt applies the mask on its next cycle
+        if (!(TIMSK2 & (1 << OCIE2A)))
+            WriteLEDs(mask);
+    }
+}
+
+void LED_Brightness(uint8_t level)
+{
+    if (level > LED_BRIGHTNESS_MAX)
+        level = LED_BRIGHTNESS_MAX;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        ledLevel = level;
+        UpdateTimer();
+    }
+}
+
+void LED_Blink(uint8_t mask, uint8_t pattern)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        ledBlinkMask = mask;
+        ledPattern = pattern;
+        UpdateTimer();
+    }
+}
+
+ISR(TIMER2_COMPA_vect)
+{
+    if (++ledTicks == LED_BLINK_PERIOD_MS) {
+        ledTicks = 0;
+        ledPattern = (ledPattern >> 1) | (ledPattern << 7);
+    }
+
+    uint8_t mask = ledMask;
+    if (!(ledPattern & 1))
+        mask &= ~ledBlinkMask;
+    if (ledPhase >= ledLevel)
+        mask = 0;
+    ledPhase = (ledPhase + 1) & (LED_BRIGHTNESS_MAX - 1);
+
+    WriteLEDs(mask);
+}
@@ -0,0 +1,65 @@
+/**
+ * File: led.hpp
+ * -------------
+ * Driver of the 4 diodes available on the board, wired on PORTB2..PORTB5 and lit when their pin is low.
+ *
+ * The diodes are handled as a 4-bit mask (bit 0 is LED4, ..., bit 3 is LED1), applied to the port in a single masked
+ * write so they never glitch between an 'off' and an 'on'. Brightness and blinking are optional : they are driven by
+ * the Timer2 compare interrupt, which is only enabled while one of them is in use.
+ */
+
+#ifndef _led_
+#define _led_
+
+#include <avr/io.h>
+#include <stdint.h>
+
+// LED macros
+#define LED4 PORTB2
+#define LED3 PORTB3
+#define LED2 PORTB4
+#define LED1 PORTB5
+
+// Bits of the diodes in PORTB
+#define LED_PORT_MASK ((1 << LED4) | (1 << LED3) | (1 << LED2) | (1 << LED1))
+
+// Mask of the diodes showing a number of lives (or a difficulty level) : 1 is LED4 only, 4 is every diode
+#define LED_COUNT_MASK(n) ((uint8_t) ((1 << (n)) - 1))
+
+// Number of brightness steps ; LED_BRIGHTNESS_MAX means fully on, without any PWM
+#define LED_BRIGHTNESS_MAX 8
+
+// Blink patterns : one bit per period of LED_BLINK_PERIOD_MS, read from bit 0 to bit 7 and repeated
+#define LED_BLINK_PERIOD_MS 128
+#define LED_BLINK_SLOW 0x0F
+#define LED_BLINK_FAST 0x55
+
+/**
+ * Function: LED_Init
+ * Configures the diodes' pins as outputs and turns every diode off.
+ */
+void LED_Init(void);
+
+/**
+ * Function: LED_Set(uint8_t)
+ * Turns on the diodes of the mask and turns off the others, in a single write of PORTB.
+ * @param mask - diodes to turn on : bit 0 is LED4, ..., bit 3 is LED1.
+ */
+void LED_Set(uint8_t mask);
+
+/**
+ * Function: LED_Brightness(uint8_t)
+ * Sets the brightness of the diodes which are on.
+ * @param level - 0 (off) to LED_BRIGHTNESS_MAX (fully on).
+ */
+void LED_Brightness(uint8_t level);
+
+/**
+ * Function: LED_Blink(uint8_t, uint8_t)
+ * Makes some of the diodes which are on blink with a given pattern.
+ * @param mask - diodes to blink, with the same layout as in LED_Set ; 0 stops blinking.
+ * @param pattern - 8 periods of LED_BLINK_PERIOD_MS, a diode being on during the periods whose bit is set.
+ */
+void LED_Blink(uint8_t mask, uint8_t pattern);
+
+#endif
@@ -18,6 +18,7 @@
 
 // Import standard C++ libraries
 #include <avr/io.h>
+#include <avr/interrupt.h>
 #include <util/delay.h>
 #include <string.h>
 #include <stdio.h>
@@ -28,6 +29,14 @@
 #include "uartLib/uart.hpp"
 #include "hd44780/HD44780.hpp"
 #include "vector/vector.h"
+#include "difficulty/difficulty.hpp"
+#include "led/led.hpp"
+#include "probe/probe.hpp"
+#include "spawn/spawn.hpp"
+#include "console/console.hpp"
+#include "clock/clock.hpp"
+#include "latency/latency.hpp"
+#include "recorder/recorder.hpp"
 
 // USART configuration macros
 //#define F_CPU 16000000
@@ -40,14 +49,22 @@
 #define B3 PIND2
 #define B4 PIND3
 
-// LED macros
-#define LED4 PORTB2
-#define LED3 PORTB3
-#define LED2 PORTB4
-#define LED1 PORTB5
-
 // Constants
 #define MAX_LIVES 4
+#define MAX_OBSTACLES SPAWN_MAX_OBSTACLES // Obstacles on screen at the same time
+#define COLUMNS 16 // Characters of a line of the screen
+#define RENDER_MS 50 // Default shortest delay between two frames sent to the display, see render_ms
+#define MAX_CATCH_UP 16 // Game steps played back to back at most when late, before the time missed is given up
+#define UNKNOWN_CELL '\0' // Cell of 'shown' whose character on the display is not known : it is always written
+
+// Phases of the boot, timestamped in boot_us
+#define BOOT_LEDS 0
+#define BOOT_UART 1
+#define BOOT_ADC 2
+#define BOOT_LCD 3
+#define BOOT_FRAME 4 // the welcome screen is shown : the board can be played
+#define BOOT_PHASES 5
+#define BOOT_NAMES { "leds", "uart", "adc", "lcd", "frame" }
 
 /* -- Global variables -- */
 bool jumping = false; // Whether the player is currently jumping, or not
@@ -55,13 +72,28 @@ bool crouching = false; // Whether the player is currently crouching ,or not
 int lap = 0; // Lap in the current game
 int step = 0; // Step : 0, 1 or 2 ; defines if the character is standing or walking
 bool step_up = true; // Defines if the step is currently going up (0, next 1, next 2) or not (2, next 1, next 0)
-char* str = ""; // String variable used to display various characters on screen in the program
-double chance_gen_obs; // Chances not to generate an obstacle. The chances to generate an obstacle is 1-chance_gen_obs
+char str[32]; // String variable used to display various characters on screen in the program ; a line, and room for long numbers
+uint8_t spawn_threshold; // Random bytes below this threshold do not generate an obstacle, see Difficulty::spawn_threshold
+bool scroll_render = true; // Whether the obstacles are moved by shifting the display instead of being redrawn, see flush_frame
+uint8_t scroll_offset = 0; // DDRAM address shown in the first column of the screen, while the display is shifted
+uint16_t render_ms = RENDER_MS; // Shortest delay between two frames sent to the display, see flush_frame
+char frame[2][COLUMNS]; // Screen of the last game step, see draw_frame
+char shown[2][COLUMNS]; // Screen shown by the display, as of the last flush_frame
+uint8_t frame_steps = 0; // Game steps played since the last flush_frame : columns the obstacles moved by
+uint16_t field[2]; // Obstacles of the frame : bit x is set if an obstacle is at column x of the line, see draw_frame
+Recorder recorder; // Last game steps of the life, sent via USART after the GAME OVER screen, see report_recorder
+uint8_t injected_buttons = 0; // Buttons pressed from the console (bit b for button b), until they are handled
+bool paused = false; // Whether the game is paused from the console
+SpawnQueue spawn_queue; // Obstacles of the upcoming game steps, decided in advance from the random stream, see spawn.hpp
+uint32_t run_seed; // Seed of the whole run, from which the seed of every life is derived
+uint16_t life_count = 0; // Number of lives played since the start-up
 uint16_t ms; // Delay between each game step, in ms.
 bool restart = true; // Whether the player wants to restart a new game, or not
 uint8_t lives = MAX_LIVES; // Player's current number of lives
 int score = 0; // Player's total score
 int diff = 0; // Chosen difficulty : 1, 2, 3 or 4
+bool warm_boot = false; // Whether the last reset kept the display powered, see boot()
+uint32_t boot_us[BOOT_PHASES]; // End of every phase of the boot, in us since the start of the clock
 
 /**
  * Class: Obstacle
@@ -81,6 +113,11 @@ public:
 // Vector of obstacles
 vector obstacles;
 
+// Memory of the allocations of a life, given back all at once at the beginning of the next life
+#define LIFE_ARENA_SIZE (MAX_OBSTACLES * sizeof(Obstacle))
+alignas(__BIGGEST_ALIGNMENT__) static char life_storage[LIFE_ARENA_SIZE];
+VectorArena life_arena;
+
 /* --- Utility functions --- */
 
 /**
@@ -111,7 +148,7 @@ void clear_bit(unsigned char b) {
  * @return bool - whether the button is released, or not.
  */
 bool is_released(unsigned char b) {
-    return PIND & 1 << b;
+    return (PIND & 1 << b) && !(injected_buttons & 1 << b);
 }
 
 /**
@@ -126,11 +163,13 @@ bool is_pressed(unsigned char b) {
 
 /**
  * Function: wait(unsigned char)
- * Waits for the input of a given button.
+ * Waits for the input of a given button, running the console commands meanwhile.
  * @param b - button to wait for : B1, B2, B3 or B4.
  */
 void wait(unsigned char b) {
-    while (is_released(b));
+    while (is_released(b))
+        Console_Poll();
+    injected_buttons &= ~(1 << b);
 }
 
 /**
@@ -147,7 +186,7 @@ Obstacle *vector_get(int position) {
 
 /**
  * Function: vector_first
- * Returns the oldest element of the vector
+ * Returns the oldest element of the vector. The vector must not be empty.
  * @return  Obstacle - the first element of the vector.
  */
 Obstacle vector_first() {
@@ -156,7 +195,7 @@ Obstacle vector_first() {
 
 /**
  * Function: vector_last
- * Returns the most recent element of the vector.
+ * Returns the most recent element of the vector. The vector must not be empty.
  * @return Obstacle - the last element of the vector
  */
 Obstacle vector_last() {
@@ -169,55 +208,7 @@ Obstacle vector_last() {
  * @return bool - whether the vector is full, or not
  */
 bool vector_full() {
-    return VectorLength(&obstacles) == 8;
-}
-
-/**
- * Function: nb_of_digits(int)
- * Counts the number of digits in a number.
- * @param k - number to counts the digits from
- * @return int - number of digits in k
- * @example nb_of_digits(10) >>> 2
- * @example nb_of_digits(6192) >>> 4
- */
-int nb_of_digits(int k) {
-    int n = 0;
-    do {
-        k /= 10;
-        n++;
-    } while (k > 0);
-    return n;
-}
-
-/**
- * Function: rand_double
- * Creates a random number of type 'double' between 0 and 1.
- * To do so, generates a random number, counts the number of digits of the number, and divide it by the corresponding
- * power of 10.
- * @return double - random number generated between 0 and 1.
- */
-double rand_double() {
-    int tmp = random();
-    return tmp / (nb_of_digits(tmp)*10);
-}
-
-/**
- * Function: on(unsigned char)
- * Turns on the LED passed as parameter.
- * @param LED - diode to turn on : LED1, LED2, LED3 or LED4.
- */
-void on(unsigned char LED) {
-    // Turns on the LED passed as parameter
-    PORTB &= ~(1<<LED);
-}
-
-/**
- * Function: off(unsigned char)
- * Turns off the LED passed as parameter.
- * @param LED - diode to turn off : LED1, LED2, LED3 or LED4.
- */
-void off(unsigned char LED) {
-    PORTB |= (1<<LED);
+    return VectorLength(&obstacles) == MAX_OBSTACLES;
 }
 
 /**
@@ -244,10 +235,80 @@ void debug(char *s) {
 
 /**
  * Function: init_obstacles
- * Initialize the vector of obstacles.
+ * Initialize the vector of obstacles, in the memory of the life arena.
+ * The arena is reset first : the obstacles of the previous life are given back in constant time, and the vector never
+ * takes more than LIFE_ARENA_SIZE bytes, whatever the number of lives played.
  */
 void init_obstacles() {
-    VectorNew(&obstacles, sizeof(Obstacle), NULL, 8);
+    VectorArenaReset(&life_arena);
+    VectorAllocator allocator = VectorArenaAllocator(&life_arena);
+    VectorNewWith(&obstacles, sizeof(Obstacle), NULL, MAX_OBSTACLES, &allocator, 0);
+}
+
+/**
+ * Function: report_life_arena
+ * Send the high-water mark of the life arena via USART.
+ */
+void report_life_arena() {
+    char report[32];
+    sprintf(report, "arena: %u/%u bytes", (unsigned) life_arena.highWater, (unsigned) life_arena.size);
+    debug(report);
+}
+
+/**
+ * Function: report_lcd_queue
+ * Send the statistics of the LCD queue during the life via USART : bytes sent, deepest queue, and bytes which had to
+ * wait for room in the queue.
+ */
+void report_lcd_queue() {
+    char report[48];
+    LCD_QueueStats stats;
+    LCD_GetQueueStats(&stats);
+    sprintf(report, "lcd: %u bytes, depth %u/%u, stalls %u", stats.queued, stats.maxDepth, LCD_QUEUE_SIZE,
+            stats.stalls);
+    debug(report);
+}
+
+/**
+ * Function: report_boot
+ * Send the time at which every phase of the boot ended via USART, from the start of the clock.
+ */
+void report_boot() {
+    static const char *const names[BOOT_PHASES] = BOOT_NAMES;
+    char report[96];
+    int length = sprintf(report, "boot: %s,", warm_boot ? "warm" : "cold");
+    for (uint8_t phase = 0 ; phase < BOOT_PHASES ; phase++)
+        length += sprintf(report + length, " %s %lu", names[phase], (unsigned long) boot_us[phase]);
+    strcpy(report + length, " us");
+    debug(report);
+}
+
+/**
+ * Function: report_recorder
+ * Send the last game steps of the life via USART, from the oldest one : the age of the step, both lines of obstacles
+ * ('-') with the column where they appear, the pose ('^' jump, 'v' crouch), 'F' if the frame was sent after the step,
+ * '+' if the step was played late right after the previous one, how late it started and the time it took.
+ */
+void report_recorder() {
+    char report[64];
+    sprintf(report, "steps: last %u of %d", recorder.count, lap);
+    debug(report);
+    for (uint8_t i = 0 ; i < recorder.count ; i++) {
+        const RecorderEntry *e = recorder_get(&recorder, i);
+        char lines[2][COLUMNS + 2];
+        for (uint8_t y = 0 ; y < 2 ; y++) {
+            uint16_t obstacles = y == 0 ? e->top : e->bottom;
+            for (uint8_t x = 0 ; x < COLUMNS ; x++)
+                lines[y][x] = obstacles & (1U << x) ? '-' : '.';
+            lines[y][COLUMNS] = e->events & (y == 0 ? RECORDER_SPAWN_TOP : RECORDER_SPAWN_BOTTOM) ? '-' : '.';
+            lines[y][COLUMNS + 1] = '\0';
+        }
+        char pose = e->events & RECORDER_JUMP ? '^' : e->events & RECORDER_CROUCH ? 'v' : '.';
+        sprintf(report, "%3d %s %s %c%c%c %u ms %u us", i - recorder.count + 1, lines[0], lines[1], pose,
+                e->events & RECORDER_FLUSH ? 'F' : '.', e->events & RECORDER_CATCH_UP ? '+' : '.', e->late_ms,
+                e->step_us);
+        debug(report);
+    }
 }
 
 /**
@@ -270,71 +331,60 @@ void debug_obstacles() {
 
 /**
  * Function: generate_obstacle
- * Generate, or not, an obstacle, depending on generated random numbers.
+ * Generate, or not, an obstacle, as decided in advance for this game step by the spawn queue.
+ * @return int8_t - line of the new obstacle (0 for the top line, 1 for the bottom line), or -1 if there is none
  */
-void generate_obstacle() {
+int8_t generate_obstacle() {
     //debug("generating obstacles...");
-    // Check if it is possible to generate a new obstacle
-    if (vector_last().posx <= 14 && !vector_full()) {
-        // Generate a random number to see if a new obstacle will be generated or not
-        double rd_gen_obs = rand_double();
-        if (rd_gen_obs > chance_gen_obs) {
-            // If the generated random number is greater than the chance of creating a new obstacle,
-            // create a new obstacle.
-            Obstacle new_obs;
-            new_obs.posx = 16;
-
-            // 50-50 chance for it to be on the top line or the bottom line
-            double rd_posy = rand_double();
-            if (rd_posy < 0.50)
-                new_obs.posy = 0;
-            else
-                new_obs.posy = 1;
-            // Add obstacle to vector
-            VectorAppend(&obstacles, &new_obs);
-            debug("--- New obstacle generated ---");
-        }
+    // The queue models the obstacles on its own, so it already checked that a new obstacle was possible
+    int8_t line = spawn_queue_pop(&spawn_queue);
+    if (line >= 0) {
+        // The random stream also chose the line : top (0) or bottom (1)
+        Obstacle new_obs;
+        new_obs.posx = SPAWN_X;
+        new_obs.posy = line;
+        // Add obstacle to vector
+        VectorAppend(&obstacles, &new_obs);
+        PROBE_EVENT(PROBE_OBSTACLE);
     }
+    return line;
 }
 
 /**
- * Function: update_obstacles
- * Update the obstacles : bring them 1 step closer to the player.
- * If an obstacle is behind the player (posx < 0), delete it.
+ * Function: seed_life
+ * Start the random stream of the obstacles from the seed of a new life, and decide the first game steps in advance.
+ * The seed is sent via USART so the life can be replayed on the host (see tools/spawn_solver.cpp).
  */
-void update_obstacles() {
-    for (int i = 0 ; i < VectorLength(&obstacles) ; i++) {
-        vector_get(i)->closer();
-        if (vector_get(i)->posx < 0) {
-            VectorDelete(&obstacles, i);
-            vector_get(0)->closer();
-        }
-    }
+void seed_life() {
+    char report[24];
+    uint32_t seed = spawn_life_seed(run_seed, life_count++);
+    spawn_queue_init(&spawn_queue, seed, spawn_threshold);
+    spawn_queue_fill(&spawn_queue);
+    sprintf(report, "seed: %lu", (unsigned long) seed);
+    debug(report);
 }
 
 /**
- * Function: disp_obstacles
- * Draw the obstacles on screen.
+ * Function: move_obstacle
+ * Brings an obstacle 1 step closer to the player. Predicate of VectorRemoveIf.
+ * @param elemAddr - address of the obstacle
+ * @return bool - whether the obstacle is now behind the player (posx < 0) and must be deleted
  */
-void disp_obstacles() {
-    disp(1, 0, "               ");
-    disp(1, 1, "               ");
+bool move_obstacle(void *elemAddr, void *) {
+    Obstacle *obs = static_cast<Obstacle *>(elemAddr);
+    obs->closer();
+    return obs->posx < 0;
+}
 
-    Obstacle *obs;
-    for (int i = 0 ; i < VectorLength(&obstacles) ; i++) {
-        obs = vector_get(i);
-        char *c;
-        // If the obstacle collides with the player's head, write 'x'.
-        if (obs->posx == 0 && obs->posy == 0 && !crouching)
-            c = "x";
-        // If the obstacle collides with the player's legs, write 'X'.
-        else if (obs->posx == 0 && obs->posy == 1 && !jumping)
-            c = "X";
-        // Else, write '-'.
-        else
-            c = "-";
-        disp(obs->posx, obs->posy, c);
-    }
+/**
+ * Function: update_obstacles
+ * Update the obstacles : bring them 1 step closer to the player.
+ * If an obstacle is behind the player (posx < 0), delete it.
+ * Both are done in a single pass over the vector, which keeps the obstacles in order.
+ */
+void update_obstacles() {
+    VectorRemoveIf(&obstacles, move_obstacle, NULL);
+    frame_steps++;
 }
 
 /* --- Game update / run functions --- */
@@ -344,25 +394,8 @@ void disp_obstacles() {
  * Update the diodes regarding the number of lives left.
  */
 void update_LEDs() {
-    // Turn off all the diodes (in case of a reset).
-    off(LED1);
-    off(LED2);
-    off(LED3);
-    off(LED4);
-
-    // Turn on the correct diodes
-    if (lives == 4) {
-        on(LED1);
-    }
-    if (lives >= 3) {
-        on(LED2);
-    }
-    if (lives >= 2) {
-        on(LED3);
-    }
-    if (lives >= 1) {
-        on(LED4);
-    }
+    // One diode per life left, turned on and off in a single write
+    LED_Set(LED_COUNT_MASK(lives));
 }
 
 /**
@@ -386,38 +419,74 @@ void update_step() {
 }
 
 /**
- * Function: disp_player
- * Draws the player on the screen on position (0,0) and (0,1). Draw only (0,0) is the player is jumping, or only (0,1)
- * if the player is crouching.
+ * Function: draw_frame
+ * Draws the player and the obstacles of the current game step in the frame, with 'x' or 'X' where an obstacle hits the
+ * player, and the obstacles in 'field'. Nothing is sent to the display until flush_frame.
  */
-void disp_player() {
-    //debug("displaying player...");
-    disp(0,0," ");
-    disp(0,1," ");
+void draw_frame() {
+    memset(frame, ' ', sizeof(frame));
+    field[0] = field[1] = 0;
+    for (int i = 0 ; i < VectorLength(&obstacles) ; i++) {
+        Obstacle *obs = vector_get(i);
+        if (obs->posx < COLUMNS) {
+            frame[obs->posy][obs->posx] = '-';
+            field[obs->posy] |= 1U << obs->posx;
+        }
+    }
 
-    if (jumping)
-        disp(0,0,"o");
-    else if (crouching)
-        disp(0, 1, "o");
-    else {
-        char* bottom;
-        switch(step) {
-            case 0:
-                bottom = ">";
-                break;
-            case 1:
-                bottom = "|";
-                break;
-            case 2:
-                bottom = ">";
-                break;
-            default:
-                bottom = "A";
+    char top = jumping || !crouching ? 'o' : ' ';
+    char bottom = crouching ? 'o' : jumping ? ' ' : (step == 1 ? '|' : '>');
+    if (frame[0][0] == '-')
+        top = crouching ? '-' : 'x';
+    if (frame[1][0] == '-')
+        bottom = jumping ? '-' : 'X';
+    frame[0][0] = top;
+    frame[1][0] = bottom;
+}
+
+/**
+ * Function: flush_frame
+ * Sends the frame to the display : only the cells which differ from the screen shown, a run of cells on a line after a
+ * single LCD_GoTo. In scrolling mode, the display is first shifted by the game steps played since the last flush,
+ * which brings the obstacles already shown to their place without writing them : the entering columns and the player's
+ * column are left to write. Several game steps thus cost one flush, hardly more than a single one.
+ * The display must have been cleared (or sent home) at the beginning of the game, and must be sent home at the end.
+ */
+void flush_frame() {
+    // Past a screen of steps, nothing shown is left to reuse
+    uint8_t shifts = scroll_render && frame_steps < COLUMNS ? frame_steps : 0;
+    frame_steps = 0;
+    for (uint8_t i = 0 ; i < shifts ; i++)
+        LCD_ShiftLeft();
+    if (shifts > 0) {
+        scroll_offset = (scroll_offset + shifts) % HD44780_DDRAM_LINE_LENGTH;
+        for (uint8_t y = 0 ; y < 2 ; y++) {
+            memmove(shown[y], shown[y] + shifts, COLUMNS - shifts);
+            memset(shown[y] + COLUMNS - shifts, UNKNOWN_CELL, shifts);
         }
-        disp(0, 0, "o");
-        disp(0, 1, bottom);
     }
-    //debug("done - displaying player");
+
+    for (uint8_t y = 0 ; y < 2 ; y++) {
+        uint8_t next = HD44780_DDRAM_LINE_LENGTH; // address the display writes next, none at first
+        for (uint8_t x = 0 ; x < COLUMNS ; x++) {
+            if (frame[y][x] == shown[y][x])
+                continue;
+            uint8_t address = (scroll_offset + x) % HD44780_DDRAM_LINE_LENGTH;
+            if (address != next)
+                LCD_GoTo(address, y);
+            LCD_WriteData(frame[y][x]);
+            shown[y][x] = frame[y][x];
+            next = address + 1;
+        }
+    }
+}
+
+/**
+ * Function: forget_shown
+ * Forgets what the display shows, so the next flush_frame writes every cell.
+ */
+void forget_shown() {
+    memset(shown, UNKNOWN_CELL, sizeof(shown));
 }
 
 /**
@@ -426,11 +495,120 @@ void disp_player() {
  * @return bool - whether the game is over or not
  */
 bool check_if_game_over() {
+    // No obstacle, no collision
+    if (VectorLength(&obstacles) == 0) {
+        return false;
+    }
     Obstacle obs = vector_first();
     return (obs.posx == 0 && obs.posy == 0 && !crouching)
         || (obs.posx == 0 && obs.posy == 1 && !jumping);
 }
 
+/* --- Console --- */
+
+/**
+ * Function: spawn_threshold_changed
+ * Applies a spawn threshold set from the console to the obstacles not decided yet.
+ */
+void spawn_threshold_changed() {
+    spawn_queue.threshold = spawn_threshold;
+}
+
+/**
+ * Function: scroll_render_changed
+ * Brings the display back from its shift when the render mode is changed from the console : both modes can go on from
+ * there, once the next flush_frame has written every cell again.
+ */
+void scroll_render_changed() {
+    LCD_Home();
+    scroll_offset = 0;
+    forget_shown();
+}
+
+/**
+ * Function: command_stats
+ * Console command sending the statistics of the current life via USART.
+ */
+void command_stats(uint8_t, char **) {
+    char report[32];
+    sprintf(report, "lap: %d, score: %d", lap, score);
+    Console_Print(report);
+    report_life_arena();
+    report_lcd_queue();
+}
+
+/**
+ * Function: command_boot
+ * Console command sending the time of the phases of the last boot via USART.
+ */
+void command_boot(uint8_t, char **) {
+    report_boot();
+}
+
+/**
+ * Function: command_inject
+ * Console command pressing a button until it is handled : by the next game step, or by the screen waiting for it.
+ */
+void command_inject(uint8_t argc, char **argv) {
+    if (argc != 2 || argv[1][0] != 'B' || argv[1][1] < '1' || argv[1][1] > '4' || argv[1][2] != '\0') {
+        Console_Print("usage: inject B1..B4");
+        return;
+    }
+    injected_buttons |= 1 << (B1 + argv[1][1] - '1');
+}
+
+/**
+ * Function: command_latency
+ * Console command sending the latencies from the presses of B2 and B3 to the display of the jump or the crouch, for
+ * every difficulty level ; 'latency reset' empties them.
+ */
+void command_latency(uint8_t argc, char **argv) {
+    if (argc == 2 && strcmp(argv[1], "reset") == 0) {
+        Latency_Reset();
+        return;
+    }
+    for (uint8_t level = 1 ; level <= LATENCY_LEVELS ; level++) {
+        char report[sizeof("diff 255: n=65535 min=4294967295 p50=4294967295 p99=4294967295 max=4294967295 us")];
+        LatencyStats stats;
+        Latency_Get(level, &stats);
+        sprintf(report, "diff %u: n=%u min=%lu p50=%lu p99=%lu max=%lu us", level, stats.count,
+                (unsigned long) stats.min, (unsigned long) stats.p50, (unsigned long) stats.p99,
+                (unsigned long) stats.max);
+        Console_Print(report);
+    }
+}
+
+/**
+ * Function: command_pause
+ * Console commands pausing and resuming the game, between two game steps.
+ */
+void command_pause(uint8_t, char **) {
+    paused = true;
+}
+
+void command_resume(uint8_t, char **) {
+    paused = false;
+}
+
+// Variables and commands of the console
+const ConsoleVar CONSOLE_VARS[] = {
+    CONSOLE_VAR("spawn", spawn_threshold, spawn_threshold_changed),
+    CONSOLE_VAR("ms", ms, NULL),
+    CONSOLE_VAR("render", render_ms, NULL),
+    CONSOLE_VAR("diff", diff, NULL),
+    CONSOLE_VAR("lives", lives, NULL),
+    CONSOLE_BOOL("scroll", scroll_render, scroll_render_changed),
+};
+
+const ConsoleCommand CONSOLE_COMMANDS[] = {
+    { "stats", command_stats, "- lap, score, memory and LCD queue" },
+    { "inject", command_inject, "B1..B4 - press a button" },
+    { "boot", command_boot, "- time of the phases of the boot" },
+    { "latency", command_latency, "[reset] - press to display latencies" },
+    { "pause", command_pause, "- pause the game" },
+    { "resume", command_resume, "- resume the game" },
+};
+
 /* --- Main functions --- */
 
 void game() {
@@ -446,98 +624,183 @@ void game() {
     disp(0,0, str);
     disp(0,1,"*--*---**---*--*");
 
+    // Initialize the obstacles vector
+    init_obstacles();
+
+    // Start the random stream of the obstacles of this life, while the player reads the screen
+    seed_life();
+
     wait(B4);
     _delay_ms(500);
 
-    // Initialize the obstacles vector
-    init_obstacles();
+    // Start from an empty screen, not shifted
+    LCD_Clear();
+    scroll_offset = 0;
+    memset(shown, ' ', sizeof(shown));
+    frame_steps = 0;
+    LCD_ResetQueueStats();
+    recorder_reset(&recorder);
+
+    // Only measure the presses made during the game
+    Latency_Discard();
+
+    // Run the game while the player has not lost. The game steps follow each other every 'ms' whatever the time spent
+    // on the display, which only gets a frame every 'render_ms' at most : the steps in between are only drawn in the
+    // frame, and sent together by the next flush_frame. A jump or a crouch is sent at once.
+    uint32_t next_step = Clock_Millis(), next_frame = next_step;
+    bool over = false, drawn = false, measured = false, pose_changed = false;
+    while (!over) {
+        uint8_t played = 0;
+        while (!over && (int32_t) (Clock_Millis() - next_step) >= 0) {
+            // Too late to catch up : the game slows down instead
+            if (played++ == MAX_CATCH_UP) {
+                next_step = Clock_Millis();
+                break;
+            }
 
-    // Run the game while the player has not lost
-    while(!check_if_game_over()) {
-        // Manually clear B1, B2, B3 and B4 inputs to avoid false inputs
-        clear_bit(B1);
-        clear_bit(B2);
-        clear_bit(B2);
-        clear_bit(B4);
+            PROBE_BEGIN(PROBE_TICK);
 
-        // Manually set jumping and crouching to false at the beginning of each step to avoid problems
-        jumping = false;
-        crouching = false;
+            // Record how late the step starts, and what happens during it
+            uint32_t started = Clock_Micros(), late_ms = Clock_Millis() - next_step;
+            uint8_t events = played > 1 ? RECORDER_CATCH_UP : 0;
 
-        // Update the position of every obstacles
-        update_obstacles();
+            // Manually clear B1, B2, B3 and B4 inputs to avoid false inputs
+            clear_bit(B1);
+            clear_bit(B2);
+            clear_bit(B2);
+            clear_bit(B4);
 
-        // Draw the player on screen
-        disp_player();
+            // Manually set jumping and crouching to false at the beginning of each step to avoid problems
+            jumping = false;
+            crouching = false;
 
-        // Generate a new obstacle
-        generate_obstacle();
+            // Update the position of every obstacles
+            PROBE_BEGIN(PROBE_UPDATE);
+            update_obstacles();
+            PROBE_END(PROBE_UPDATE);
 
-        // Draw the obstacles on screen
-        disp_obstacles();
+            // Generate a new obstacle
+            PROBE_BEGIN(PROBE_SPAWN);
+            int8_t line = generate_obstacle();
+            if (line >= 0)
+                events |= line == 0 ? RECORDER_SPAWN_TOP : RECORDER_SPAWN_BOTTOM;
+            PROBE_END(PROBE_SPAWN);
 
-        /* BUTTON 1 */
-        if (is_pressed(B1)) {
-        }
+            PROBE_BEGIN(PROBE_INPUT);
 
-        /* BUTTON 2 */
-        else if (is_pressed(B2)) {
-            // Transmit via USART for debugging purposes
-            USART_Transmit_String("jumping");
+            /* BUTTON 1 */
+            if (is_pressed(B1)) {
+            }
 
-            // Set jumping to true because the player is jumping
-            jumping = true;
+            /* BUTTON 2 */
+            else if (is_pressed(B2)) {
+                // Take the time of the press, to measure how long the jump takes to be shown
+                measured |= Latency_Begin(B2, diff);
+                PROBE_EVENT(PROBE_JUMP);
+                events |= RECORDER_JUMP;
 
-            // Draw the player again once they have jumped
-            disp_player();
+                // Set jumping to true because the player is jumping
+                jumping = true;
+                pose_changed = true;
+            }
 
-            // Draw the obstacles once again
-            disp_obstacles();
-        }
+            /* BUTTON 3 */
+            else if (is_pressed(B3)) {
+                // Take the time of the press, to measure how long the crouch takes to be shown
+                measured |= Latency_Begin(B3, diff);
+                PROBE_EVENT(PROBE_CROUCH);
+                events |= RECORDER_CROUCH;
 
-        /* BUTTON 3 */
-        else if (is_pressed(B3)) {
-            // Transmit via USART for debugging purposes
-            USART_Transmit_String("crouching");
+                // Set crouching to true because the player is crouching
+                crouching = true;
+                pose_changed = true;
+            }
 
-            // Set crouching to true because the player is crouching
-            crouching = true;
+            /* BUTTON 4 */
+            else if(is_pressed(B4)){
+                // See function debug_obstacles().
+                //debug_obstacles();
+            }
 
-            // Draw the player again once they have crouched
-            disp_player();
+            /* IDLE */
+            else {
+            }
 
-            // Draw the obstacles once again
-            disp_obstacles();
-        }
+            // The buttons pressed from the console only last one game step
+            injected_buttons = 0;
 
-        /* BUTTON 4 */
-        else if(is_pressed(B4)){
-            // See function debug_obstacles().
-            //debug_obstacles();
-        }
+            PROBE_END(PROBE_INPUT);
+
+            // Draw the player and the obstacles in the frame
+            draw_frame();
+            drawn = true;
 
-        /* IDLE */
-        else {
+            // Update the game step
+            update_step();
+
+            // Keep the step in the flight recorder, to be sent once the life is over
+            RecorderEntry *entry = recorder_add(&recorder);
+            entry->top = field[0];
+            entry->bottom = field[1];
+            uint32_t step_us = Clock_Micros() - started;
+            entry->step_us = step_us < 0xFFFF ? step_us : 0xFFFF;
+            entry->late_ms = late_ms < 0xFF ? late_ms : 0xFF;
+            entry->events = events;
+
+            PROBE_END(PROBE_TICK);
+
+            over = check_if_game_over();
+            next_step += ms > 0 ? ms : 1;
         }
 
-        // Update the game step
-        update_step();
+        // Send the frame when it is due, or at once for a new pose or the collision
+        if (drawn && (pose_changed || over || (int32_t) (Clock_Millis() - next_frame) >= 0)) {
+            PROBE_BEGIN(PROBE_RENDER);
+            flush_frame();
+            if (measured)
+                LCD_Mark();
+            recorder_last(&recorder)->events |= RECORDER_FLUSH;
+            PROBE_END(PROBE_RENDER);
+            next_frame = Clock_Millis() + render_ms;
+            drawn = measured = pose_changed = false;
+        }
 
-        // If the game is over, exit the loop before making the delay until next step
-        if (check_if_game_over())
+        // If the game is over, exit the loop before waiting for the next step
+        if (over)
             break;
 
-        // Delay until next step ---- Explanation :
-        //   It is not possible to use _delay_ms with a variable inside. The _delay_ms function wants the programmer
-        //   to use a constant number (10, 1000, 500, 491...) as a parameter. To delay with a variable, I had to use
-        //   _delay_ms(1) to delay of 1 ms, and repeat this operation in a loop that cycles 'ms' times
-        for (int i = 0 ; i < ms ; i++)
+        // Wait for the next step, or for the frame if it is due first
+        PROBE_BEGIN(PROBE_DELAY);
+        // Decide the obstacles of the upcoming steps first, while there is time to spare
+        spawn_queue_fill(&spawn_queue);
+        uint32_t wake = drawn && (int32_t) (next_frame - next_step) < 0 ? next_frame : next_step;
+        while ((int32_t) (Clock_Millis() - wake) < 0) {
+            Console_Poll();
             _delay_ms(1);
+        }
+        PROBE_END(PROBE_DELAY);
+
+        // Stay on this step while the game is paused from the console
+        if (paused) {
+            while (paused) {
+                Console_Poll();
+                _delay_ms(1);
+            }
+            next_step = Clock_Millis();
+        }
     }
+    PROBE_EVENT(PROBE_COLLISION);
+
+    // Bring the display back from its shift, for the screens
+    if (scroll_render)
+        LCD_Home();
 
     /* Game Over Screen */
     disp(0, 0, "** GAME  OVER **");
     disp(0, 1, "****************");
+    report_life_arena();
+    report_lcd_queue();
+    report_recorder();
 
     wait(B4);
     _delay_ms(1000);
@@ -564,36 +827,100 @@ void game() {
     if (lives == 0)
         return;
 
+    // Blink the diode of the life that was just lost until the player moves on
+    LED_Set(LED_COUNT_MASK(lives + 1));
+    LED_Blink(LED_COUNT_MASK(lives + 1) & ~LED_COUNT_MASK(lives), LED_BLINK_FAST);
+
     wait(B4);
+    LED_Blink(0, 0);
+    update_LEDs();
     _delay_ms(1000);
 }
 
+#ifdef __AVR__
+/**
+ * The bootloader of the Uno (optiboot) reads MCUSR and clears it before jumping to the program, and the versions which
+ * do so pass its value in r2 : it is saved before the start-up code of the C runtime uses the registers, in a byte
+ * which the start-up code does not clear either.
+ */
+uint8_t bootloader_reset_cause __attribute__((section(".noinit")));
+
+void save_reset_cause() __attribute__((naked, used, section(".init0")));
+void save_reset_cause() {
+    __asm__ __volatile__("sts %0, r2\n" : "=m" (bootloader_reset_cause));
+}
+#else
+uint8_t bootloader_reset_cause = 0;
+#endif
+
+/**
+ * Function: boot
+ * Initializes the peripherals, once per reset of the board, and timestamps every phase (see report_boot). The time
+ * until the first screen is mostly the reset sequence of the display : after a power-on, its supply voltage has to
+ * settle first ; after a reset which kept it powered (reset button, watchdog), it is only brought back to a known state,
+ * which is 5 times shorter. When the cause of the reset is not known, the boot is taken as a power-on.
+ */
+void boot() {
+    // Cause of the reset, cleared for the next one : MCUSR without a bootloader, else the copy it passed, if any
+    uint8_t reset_cause = MCUSR;
+    MCUSR = 0;
+    if (reset_cause == 0 && (bootloader_reset_cause & ~((1 << WDRF) | (1 << BORF) | (1 << EXTRF) | (1 << PORF))) == 0)
+        reset_cause = bootloader_reset_cause;
+    warm_boot = reset_cause != 0 && !(reset_cause & ((1 << PORF) | (1 << BORF)));
+
+    Clock_Init();
+    LED_Init();
+    sei();
+    boot_us[BOOT_LEDS] = Clock_Micros();
+
+    init_uart(MYUBRR);
+    Console_Init(CONSOLE_VARS, sizeof(CONSOLE_VARS) / sizeof(CONSOLE_VARS[0]),
+                 CONSOLE_COMMANDS, sizeof(CONSOLE_COMMANDS) / sizeof(CONSOLE_COMMANDS[0]));
+    boot_us[BOOT_UART] = Clock_Micros();
+
+    ADC_Init();
+    Latency_Init();
+    LCD_OnMark(Latency_End);
+    boot_us[BOOT_ADC] = Clock_Micros();
+
+    if (warm_boot)
+        LCD_Restart();
+    else
+        LCD_Initalize();
+    boot_us[BOOT_LCD] = Clock_Micros();
+}
+
 int main (){
 
-    // Set a new seed based on the current time for the Random Number Generator
-    srandom(time(NULL));
+    // Set a new seed based on the current time for the random streams of the obstacles
+    run_seed = time(NULL);
+
+    /* Initialization */
+    boot();
 
-    // Loop while the player wants to restart
+    // Loop while the player wants to restart : the peripherals are already set up, and the display only cleared
     while(restart) {
         // Initialize values of the whole run
         restart = false;
+        lives = MAX_LIVES;
         score = 0;
         lap = 0;
         step = 0;
 
-        /* Initialization */
-        DDRB |= (1<<DDB2) |    (1<<DDB3) |(1<<DDB4) | (1<<DDB5);
-        PORTB |= (1<<PORTB2) | (1<<PORTB3) | (1<<PORTB4) |(1<<PORTB5);
-
-        init_uart(MYUBRR);
-        ADC_Init();
-        LCD_Initalize();
+        VectorArenaInit(&life_arena, life_storage, sizeof(life_storage));
         LCD_Clear();
 
         /* Welcome Screen */
         disp(0, 0, "* Running Dino *");
         disp(0, 1, "**  Press B4  **");
 
+        // Time until the board can be played, after a reset
+        if (boot_us[BOOT_FRAME] == 0) {
+            LCD_Flush();
+            boot_us[BOOT_FRAME] = Clock_Micros();
+            report_boot();
+        }
+
         wait(B4);
         _delay_ms(500);
 
@@ -608,43 +935,14 @@ int main (){
             sprintf(str, "* ADC : %04dms *", adc_value);
             disp(0, 1, str);
 
-            // Turn off all the diodes
-            off(LED1);
-            off(LED2);
-            off(LED3);
-            off(LED4);
-
-            // Turn on the right diodes according to the value of the potentiometer
-            if (adc_value >= 0 && adc_value <= 256) {
-                diff = 4;
-                chance_gen_obs = 0.8;
-                on(LED1);
-                on(LED2);
-                on(LED3);
-                on(LED4);
-            } else if (adc_value > 256 && adc_value <= 512) {
-                diff = 3;
-                chance_gen_obs = 0.5;
-                off(LED1);
-                on(LED2);
-                on(LED3);
-                on(LED4);
-            } else if (adc_value > 512 && adc_value <= 768) {
-                diff = 2;
-                chance_gen_obs = 0.2;
-                off(LED1);
-                off(LED2);
-                on(LED3);
-                on(LED4);
-            } else {
-                diff = 1;
-                chance_gen_obs = 0.1;
-                off(LED1);
-                off(LED2);
-                off(LED3);
-                on(LED4);
-            }
+            // Look up the difficulty level selected by the potentiometer
+            const Difficulty &d = difficulty_for(adc_value);
+            diff = d.level;
+            spawn_threshold = d.spawn_threshold;
             ms = adc_value;
+
+            // Turn on the diodes of the difficulty level, and turn off the others
+            LED_Set(d.led_mask);
         }
 
         wait(B4);
@@ -675,12 +973,16 @@ int main (){
         disp(0, 1, "B2 - Y    B3 - N");
 
         while(!is_pressed(B2) && !is_pressed(B3))
-            if(is_pressed(B2))
-                restart = true;
+            Console_Poll();
+        restart = is_pressed(B2);
+        injected_buttons &= ~(1 << B2 | 1 << B3);
     }
 
     disp(0, 0, "* Running Dino *");
     disp(0, 1, "* Game is Over *");
 
+    // Wait for the LCD queue to be sent before leaving
+    LCD_Flush();
+
     return 0;
 }
@@ -0,0 +1,58 @@
+/**
+ * File: probe.hpp
+ * ---------------
+ * Markers of the phases of the firmware, used to measure them from outside of the program.
+ *
+ * When the firmware is built for the board with PROBES defined, a marker is a single write of the phase's identifier
+ * to the GPIOR0 register (with PROBE_END_FLAG set at the end of the phase). A simulator watching GPIOR0, such as
+ * bench/simavr_bench.cpp, gets the cycle at which every phase begins and ends at the cost of one instruction per
+ * marker. An event, which has no duration, is a single write with PROBE_EVENT_FLAG set.
+ *
+ * When the firmware is built for the host with PROBES defined, every marker is recorded with the simulated time by
+ * Probe_Record (see host/trace.cpp), which writes them as a timeline. Without PROBES, the markers compile to nothing.
+ */
+
+#ifndef _probe_
+#define _probe_
+
+// Phases of the firmware
+#define PROBE_TICK 1    // one step of the game, without the delay until the next step
+#define PROBE_UPDATE 2  // update of the obstacles
+#define PROBE_SPAWN 3   // generation of a new obstacle
+#define PROBE_RENDER 4  // drawing of the player and the obstacles on the LCD
+#define PROBE_INPUT 5   // handling of the buttons
+#define PROBE_DELAY 6   // delay until the next step
+#define PROBE_UART 7    // transmission of a message over USART
+
+// Events of the game
+#define PROBE_FIRST_EVENT 8
+#define PROBE_OBSTACLE 8  // a new obstacle appears
+#define PROBE_JUMP 9      // the player jumps
+#define PROBE_CROUCH 10   // the player crouches
+#define PROBE_COLLISION 11 // the player hits an obstacle : the life is over
+#define PROBE_COUNT 12
+
+#define PROBE_NAMES { "", "tick", "update", "spawn", "render", "input", "delay", "uart", \
+                      "obstacle", "jump", "crouch", "collision" }
+
+#define PROBE_END_FLAG 0x80
+#define PROBE_EVENT_FLAG 0x40
+
+#if defined(PROBES) && defined(__AVR__)
+#include <avr/io.h>
+#define PROBE_BEGIN(id) (GPIOR0 = (id))
+#define PROBE_END(id) (GPIOR0 = (id) | PROBE_END_FLAG)
+#define PROBE_EVENT(id) (GPIOR0 = (id) | PROBE_EVENT_FLAG)
+#elif defined(PROBES)
+#include <stdint.h>
+void Probe_Record(uint8_t marker);
+#define PROBE_BEGIN(id) Probe_Record(id)
+#define PROBE_END(id) Probe_Record((id) | PROBE_END_FLAG)
+#define PROBE_EVENT(id) Probe_Record((id) | PROBE_EVENT_FLAG)
+#else
+#define PROBE_BEGIN(id) ((void) 0)
+#define PROBE_END(id) ((void) 0)
+#define PROBE_EVENT(id) ((void) 0)
+#endif
+
+#endif
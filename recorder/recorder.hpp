@@ -0,0 +1,104 @@
+/**
+ * File: recorder.hpp
+ * ------------------
+ * Flight recorder of the game steps : what happened during the last RECORDER_SIZE steps of a life, kept in RAM and
+ * sent via USART once the life is over.
+ *
+ * Sending text while the game runs takes the time of the steps (a message at 9600 baud is a few ms), and changes the
+ * timing it is meant to show. A step only writes an entry of 8 bytes in a ring instead, which costs a few stores, and
+ * the ring is read on the GAME OVER screen, when the player is waiting anyway : every lost life comes with the steps
+ * which led to it.
+ */
+
+#ifndef _recorder_
+#define _recorder_
+
+#include <stdint.h>
+
+#define RECORDER_SIZE 16        // last game steps kept, as many as an obstacle takes to cross the screen (a power of 2)
+
+// Events of a game step
+#define RECORDER_JUMP 0x01      // B2 was pressed
+#define RECORDER_CROUCH 0x02    // B3 was pressed
+#define RECORDER_SPAWN_TOP 0x04 // a new obstacle appeared on the top line, after the last column of the screen
+#define RECORDER_SPAWN_BOTTOM 0x08 // the same, on the bottom line
+#define RECORDER_FLUSH 0x10     // the frame was sent to the display after the step
+#define RECORDER_CATCH_UP 0x20  // the step was played late, right after the previous one
+
+/**
+ * Struct: RecorderEntry
+ * A game step.
+ * @public top, bottom - obstacles on screen after the step : bit x is set if an obstacle is at column x of the line
+ * @public step_us - time the step took, without the display's flush (65535 if longer)
+ * @public late_ms - time from when the step was due to when it started (255 if longer)
+ * @public events - RECORDER_* flags
+ */
+struct RecorderEntry {
+    uint16_t top, bottom;
+    uint16_t step_us;
+    uint8_t late_ms;
+    uint8_t events;
+};
+
+/**
+ * Struct: Recorder
+ * Ring of the last game steps.
+ * @public entries - the steps, the oldest being overwritten first
+ * @public next - index of the entry of the next step
+ * @public count - number of steps recorded, up to RECORDER_SIZE
+ */
+struct Recorder {
+    RecorderEntry entries[RECORDER_SIZE];
+    uint8_t next;
+    uint8_t count;
+};
+
+static_assert((RECORDER_SIZE & (RECORDER_SIZE - 1)) == 0 && RECORDER_SIZE <= 128,
+              "RECORDER_SIZE must be a power of 2, at most 128");
+
+/**
+ * Function: recorder_reset(Recorder*)
+ * Forgets the steps recorded, for a new life.
+ * @param r - recorder to reset
+ */
+inline void recorder_reset(Recorder *r) {
+    r->next = 0;
+    r->count = 0;
+}
+
+/**
+ * Function: recorder_add(Recorder*)
+ * Takes the entry of a new step, to be filled by the caller ; the oldest step is forgotten if the ring is full.
+ * @param r - recorder of the life
+ * @return RecorderEntry* - entry of the step
+ */
+inline RecorderEntry *recorder_add(Recorder *r) {
+    RecorderEntry *e = &r->entries[r->next];
+    r->next = (r->next + 1) & (RECORDER_SIZE - 1);
+    if (r->count < RECORDER_SIZE)
+        r->count++;
+    return e;
+}
+
+/**
+ * Function: recorder_last(Recorder*)
+ * Entry of the last step recorded, such as to add the events which come after the step. The recorder must not be empty.
+ * @param r - recorder of the life
+ * @return RecorderEntry* - entry of the last step
+ */
+inline RecorderEntry *recorder_last(Recorder *r) {
+    return &r->entries[(r->next - 1) & (RECORDER_SIZE - 1)];
+}
+
+/**
+ * Function: recorder_get(const Recorder*, uint8_t)
+ * Entry of a step recorded, from the oldest one.
+ * @param r - recorder of the life
+ * @param i - index of the step, from 0 (the oldest one) to count - 1 (the last one)
+ * @return const RecorderEntry* - entry of the step
+ */
+inline const RecorderEntry *recorder_get(const Recorder *r, uint8_t i) {
+    return &r->entries[(r->next - r->count + i) & (RECORDER_SIZE - 1)];
+}
+
+#endif
@@ -0,0 +1,198 @@
+/**
+ * File: spawn.hpp
+ * ---------------
+ * Random stream of the obstacles, shared by the firmware and the host tools.
+ *
+ * The random bytes come from a xorshift32 generator instead of the C library's random(), whose sequence differs
+ * between avr-libc and the host (and which costs a 32-bit division per call on the AVR). With the same seed and the same
+ * difficulty, the firmware and the host tools (such as tools/spawn_solver.cpp) see the same obstacles.
+ *
+ * The obstacles move one column per game step whatever the player does, so the stream only depends on the seed and
+ * on the spawn threshold of the difficulty. Every life starts its stream from its own seed (see spawn_life_seed), which
+ * the firmware reports via USART : the host tools can replay the obstacles of any life.
+ *
+ * For the same reason, the decisions of the upcoming game steps can be made in advance : a SpawnQueue keeps its own
+ * model of the columns taken by the obstacles, and is filled when the firmware has nothing else to do. A game step
+ * then only pops the decision made for it.
+ */
+
+#ifndef _spawn_
+#define _spawn_
+
+#include <stdint.h>
+
+#define SPAWN_X 16              // column where the obstacles appear, right after the last column of the screen
+#define SPAWN_MIN_GAP 2         // columns between an obstacle and the next one, at least
+#define SPAWN_MAX_OBSTACLES 8   // obstacles on screen at the same time, at most
+#define SPAWN_DEFAULT_SEED 0x2545F491UL // used instead of 0, which the generator never leaves
+#define SPAWN_QUEUE_SIZE 16     // game steps decided in advance by a SpawnQueue, at most (a power of 2)
+
+/**
+ * Struct: SpawnRng
+ * State of the generator of the random stream.
+ * @public state - last 32-bit value of the xorshift32 sequence, never 0.
+ */
+struct SpawnRng {
+    uint32_t state;
+};
+
+/**
+ * Function: spawn_seed(SpawnRng*, uint32_t)
+ * Restarts the random stream from a seed.
+ * @param rng - generator to seed
+ * @param seed - seed of the stream ; 0 selects SPAWN_DEFAULT_SEED
+ */
+inline void spawn_seed(SpawnRng *rng, uint32_t seed) {
+    rng->state = seed != 0 ? seed : SPAWN_DEFAULT_SEED;
+}
+
+/**
+ * Function: spawn_life_seed(uint32_t, uint16_t)
+ * Derives the seed of a life from the seed of the run and the number of the life, by mixing them with the finalizer
+ * of MurmurHash3. The streams of the lives don't overlap the way consecutive states of a single stream would.
+ * @param run_seed - seed of the run
+ * @param life - number of the life in the run
+ * @return uint32_t - seed of the life's stream
+ */
+inline uint32_t spawn_life_seed(uint32_t run_seed, uint16_t life) {
+    uint32_t x = run_seed + life * 0x9E3779B9UL;
+    x ^= x >> 16;
+    x *= 0x85EBCA6BUL;
+    x ^= x >> 13;
+    x *= 0xC2B2AE35UL;
+    x ^= x >> 16;
+    return x;
+}
+
+/**
+ * Function: spawn_byte(SpawnRng*)
+ * Draws the next random byte of the stream : the high byte of the next xorshift32 value.
+ * @param rng - generator to draw from
+ * @return uint8_t - random number between 0 and 255
+ */
+inline uint8_t spawn_byte(SpawnRng *rng) {
+    uint32_t x = rng->state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    rng->state = x;
+    return (uint8_t) (x >> 24);
+}
+
+/**
+ * Function: spawn_allowed(int, int)
+ * Checks if a new obstacle may be generated, given the obstacles already on screen.
+ * @param count - number of obstacles on screen
+ * @param last_x - column of the most recent obstacle (ignored when there is none)
+ * @return bool - whether a new obstacle may be generated, or not
+ */
+inline bool spawn_allowed(int count, int last_x) {
+    return count < SPAWN_MAX_OBSTACLES && (count == 0 || last_x <= SPAWN_X - SPAWN_MIN_GAP);
+}
+
+/**
+ * Function: spawn_next(SpawnRng*, uint8_t, bool)
+ * Decides whether an obstacle is generated at this game step, and on which line. A random byte is drawn only when
+ * spawning is allowed, and a second one only when an obstacle is generated, so the stream stays the same on every
+ * platform as long as spawn_allowed gives the same answers.
+ * @param rng - generator of the stream
+ * @param threshold - spawn threshold of the difficulty, see Difficulty::spawn_threshold
+ * @param allowed - result of spawn_allowed for the current obstacles
+ * @return int8_t - line of the new obstacle (0 for the top line, 1 for the bottom line), or -1 if there is none
+ */
+inline int8_t spawn_next(SpawnRng *rng, uint8_t threshold, bool allowed) {
+    if (!allowed || spawn_byte(rng) < threshold)
+        return -1;
+    return spawn_byte(rng) & 1;
+}
+
+/**
+ * Struct: SpawnQueue
+ * Decisions of the upcoming game steps, made in advance from the random stream.
+ * @public rng - generator of the stream
+ * @public threshold - spawn threshold of the difficulty
+ * @public columns - columns of the obstacles after the last decided step : bit x is set if an obstacle is at column x
+ * @public count - number of obstacles after the last decided step
+ * @public last_x - column of the most recent obstacle after the last decided step
+ * @public lines - ring of the decided steps, as returned by spawn_next
+ * @public head - index of the next step to pop in 'lines'
+ * @public length - number of decided steps not popped yet
+ */
+struct SpawnQueue {
+    SpawnRng rng;
+    uint8_t threshold;
+    uint32_t columns;
+    uint8_t count;
+    int8_t last_x;
+    int8_t lines[SPAWN_QUEUE_SIZE];
+    uint8_t head;
+    uint8_t length;
+};
+
+static_assert((SPAWN_QUEUE_SIZE & (SPAWN_QUEUE_SIZE - 1)) == 0, "SPAWN_QUEUE_SIZE must be a power of 2");
+static_assert(SPAWN_X < 32, "The columns of SpawnQueue must fit in 32 bits");
+
+/**
+ * Function: spawn_queue_init(SpawnQueue*, uint32_t, uint8_t)
+ * Starts an empty queue for a new life, without any obstacle on screen.
+ * @param q - queue to start
+ * @param seed - seed of the life's stream
+ * @param threshold - spawn threshold of the difficulty
+ */
+inline void spawn_queue_init(SpawnQueue *q, uint32_t seed, uint8_t threshold) {
+    spawn_seed(&q->rng, seed);
+    q->threshold = threshold;
+    q->columns = 0;
+    q->count = 0;
+    q->last_x = 0;
+    q->head = 0;
+    q->length = 0;
+}
+
+/**
+ * Function: spawn_queue_decide(SpawnQueue*)
+ * Decides one more game step : moves the modelled obstacles one column closer, dropping the one leaving column 0 the
+ * same way as update_obstacles() in main.cpp, then draws the decision of the step. The queue must not be full.
+ * @param q - queue to add the step to
+ */
+inline void spawn_queue_decide(SpawnQueue *q) {
+    if (q->columns & 1)
+        q->count--;
+    q->columns >>= 1;
+    q->last_x--;
+
+    int8_t line = spawn_next(&q->rng, q->threshold, spawn_allowed(q->count, q->last_x));
+    if (line >= 0) {
+        q->columns |= 1UL << SPAWN_X;
+        q->count++;
+        q->last_x = SPAWN_X;
+    }
+    q->lines[(q->head + q->length++) & (SPAWN_QUEUE_SIZE - 1)] = line;
+}
+
+/**
+ * Function: spawn_queue_fill(SpawnQueue*)
+ * Decides game steps in advance until the queue is full. Meant to be called when there is time to spare.
+ * @param q - queue to fill
+ */
+inline void spawn_queue_fill(SpawnQueue *q) {
+    while (q->length < SPAWN_QUEUE_SIZE)
+        spawn_queue_decide(q);
+}
+
+/**
+ * Function: spawn_queue_pop(SpawnQueue*)
+ * Takes the decision of the next game step. If the queue was not filled in time, the step is decided on the spot.
+ * @param q - queue to pop from
+ * @return int8_t - line of the new obstacle of the step, or -1 if there is none, see spawn_next
+ */
+inline int8_t spawn_queue_pop(SpawnQueue *q) {
+    if (q->length == 0)
+        spawn_queue_decide(q);
+    int8_t line = q->lines[q->head];
+    q->head = (q->head + 1) & (SPAWN_QUEUE_SIZE - 1);
+    q->length--;
+    return line;
+}
+
+#endif
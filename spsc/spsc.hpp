@@ -0,0 +1,144 @@
+/**
+ * File: spsc.hpp
+ * --------------
+ * Lock-free ring buffer between a single producer and a single consumer, such as an interrupt handler and the main
+ * program, or two threads on the host.
+ *
+ * The producer only writes the tail, and the consumer only writes the head : neither side ever waits for the other,
+ * and none of them has to disable the interrupts. The indices are 8-bit counters which run freely and wrap around, so
+ * a full ring is told apart from an empty one without wasting an item, and the capacity is at most 128 items.
+ *
+ * On the AVR, a byte is read and written in a single instruction, so a volatile index is atomic ; a compiler barrier
+ * keeps the accesses to the items on their side of the accesses to the indices (the AVR does not reorder the memory
+ * accesses itself). On the host, the indices are std::atomic, with the release stores and acquire loads giving the
+ * same ordering between threads.
+ */
+
+#ifndef _spsc_
+#define _spsc_
+
+#include <stdint.h>
+#ifndef __AVR__
+#include <atomic>
+#endif
+
+#ifdef __AVR__
+#define SPSC_INDEX_ALIGN 1
+typedef volatile uint8_t SpscIndex;
+
+inline uint8_t spsc_load(const SpscIndex &index) {
+    uint8_t value = index;
+    __asm__ __volatile__("" ::: "memory");
+    return value;
+}
+
+inline void spsc_store(SpscIndex &index, uint8_t value) {
+    __asm__ __volatile__("" ::: "memory");
+    index = value;
+}
+
+inline uint8_t spsc_own(const SpscIndex &index) {
+    return index;
+}
+#else
+#define SPSC_INDEX_ALIGN 64     // a cache line per index, so the threads do not take the line of each other's index
+typedef std::atomic<uint8_t> SpscIndex;
+
+inline uint8_t spsc_load(const SpscIndex &index) {
+    return index.load(std::memory_order_acquire);
+}
+
+inline void spsc_store(SpscIndex &index, uint8_t value) {
+    index.store(value, std::memory_order_release);
+}
+
+inline uint8_t spsc_own(const SpscIndex &index) {
+    return index.load(std::memory_order_relaxed);
+}
+#endif
+
+/**
+ * Class: Spsc
+ * Ring of up to Capacity items of type T. push is only called by the producer, and pop by the consumer ; the other
+ * functions may be called by both.
+ * @param T - type of the items, copied in and out of the ring
+ * @param Capacity - items the ring holds, at most : a power of 2, from 2 to 128
+ */
+template <typename T, uint8_t Capacity>
+class Spsc {
+    static_assert(Capacity >= 2 && Capacity <= 128 && (Capacity & (Capacity - 1)) == 0,
+                  "The capacity of Spsc must be a power of 2, from 2 to 128");
+
+public:
+    Spsc() : head(0), tail(0) {}
+
+    /**
+     * Function: push(const T&)
+     * Adds an item at the tail of the ring. Producer only.
+     * @param item - item to copy in the ring
+     * @return bool - whether the item was added, or the ring was full
+     */
+    bool push(const T &item) {
+        uint8_t t = spsc_own(tail);
+        if ((uint8_t) (t - spsc_load(head)) == Capacity)
+            return false;
+        items[t & (Capacity - 1)] = item;
+        spsc_store(tail, t + 1);
+        return true;
+    }
+
+    /**
+     * Function: pop(T*)
+     * Takes the item at the head of the ring. Consumer only.
+     * @param item - where to copy the item
+     * @return bool - whether an item was taken, or the ring was empty
+     */
+    bool pop(T *item) {
+        uint8_t h = spsc_own(head);
+        if (h == spsc_load(tail))
+            return false;
+        *item = items[h & (Capacity - 1)];
+        spsc_store(head, h + 1);
+        return true;
+    }
+
+    /**
+     * Function: size
+     * @return uint8_t - items in the ring : exact for the producer and the consumer, as long as the other side does
+     *                   not move meanwhile
+     */
+    uint8_t size() const {
+        return spsc_load(tail) - spsc_load(head);
+    }
+
+    bool empty() const {
+        return size() == 0;
+    }
+
+    bool full() const {
+        return size() == Capacity;
+    }
+
+    /**
+     * Function: pushed
+     * @return uint8_t - items pushed since the ring was created, modulo 256
+     */
+    uint8_t pushed() const {
+        return spsc_load(tail);
+    }
+
+    /**
+     * Function: popped
+     * @return uint8_t - items popped since the ring was created, modulo 256
+     */
+    uint8_t popped() const {
+        return spsc_load(head);
+    }
+
+private:
+    T items[Capacity];
+    alignas(SPSC_INDEX_ALIGN) SpscIndex head; // index of the next item to pop, written by the consumer
+    alignas(SPSC_INDEX_ALIGN) SpscIndex tail; // index of the next item to push, written by the producer
+};
+
+#endif
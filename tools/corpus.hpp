@@ -0,0 +1,335 @@
+/**
+ * File: corpus.hpp
+ * ----------------
+ * Columnar store of simulated games, written by the host tools (tools/lockstep_sim.cpp) and read by
+ * tools/corpus_query.cpp.
+ *
+ * A corpus file starts with a CorpusFileHeader, followed by blocks of up to CORPUS_BLOCK_GAMES games. A block is a
+ * CorpusBlockHeader and the columns of its games, one after the other, each starting on a multiple of 8 bytes :
+ *   - seed        uint32_t[games]     seed of the game (the seed of a life, as sent by the board)
+ *   - level       uint8_t[games]      difficulty level
+ *   - laps        uint32_t[games]     game steps survived
+ *   - score       uint32_t[games]     laps * level, as counted by game() in main.cpp
+ *   - input_start uint32_t[games + 1] offset of the inputs of every game in the inputs column
+ *   - inputs      uint8_t[]           pose of the player at every game step, 2 bits per step (CORPUS_INPUT_*), the
+ *                                     first step in the low bits ; the inputs of a game start on a new byte
+ *
+ * The file is only ever appended to : a writer buffers a block in memory and writes it whole. A reader maps the file
+ * and reads the columns where they lie, without copying nor parsing them, so a scan over the games goes as fast as the
+ * pages come from the disk. A block cut short (by a writer which did not finish) ends the corpus, and is dropped by
+ * the next writer. The integers are stored in the byte order of the host.
+ */
+
+#ifndef _corpus_
+#define _corpus_
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define CORPUS_MAGIC "DINOGAME"     // first bytes of a corpus file
+#define CORPUS_VERSION 1
+#define CORPUS_BLOCK_MAGIC 0x4B4C4243UL // "CBLK"
+#define CORPUS_BLOCK_GAMES 65536    // games per block, at most
+
+// Poses of the player at a game step
+#define CORPUS_INPUT_NONE 0
+#define CORPUS_INPUT_JUMP 1         // B2
+#define CORPUS_INPUT_CROUCH 2       // B3
+
+struct CorpusFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+};
+
+struct CorpusBlockHeader {
+    uint32_t magic;
+    uint32_t games;
+    uint64_t size;                  // bytes of the block, header included
+};
+
+/**
+ * Struct: CorpusBlock
+ * Columns of a block, pointing into the mapped file.
+ */
+struct CorpusBlock {
+    uint32_t games;
+    const uint32_t *seed;
+    const uint8_t *level;
+    const uint32_t *laps;
+    const uint32_t *score;
+    const uint32_t *input_start;
+    const uint8_t *inputs;
+};
+
+/**
+ * Struct: CorpusWriter
+ * Block being filled, and the file it is appended to.
+ */
+struct CorpusWriter {
+    FILE *file;
+    uint32_t games;
+    uint32_t seed[CORPUS_BLOCK_GAMES];
+    uint8_t level[CORPUS_BLOCK_GAMES];
+    uint32_t laps[CORPUS_BLOCK_GAMES];
+    uint32_t score[CORPUS_BLOCK_GAMES];
+    uint32_t input_start[CORPUS_BLOCK_GAMES + 1];
+    uint8_t *inputs;
+    uint32_t inputs_capacity;
+};
+
+/**
+ * Struct: Corpus
+ * Mapped corpus file, read one block after the other.
+ */
+struct Corpus {
+    const uint8_t *data;
+    size_t size;
+    size_t next;                    // offset of the next block
+};
+
+/**
+ * Function: corpus_align(uint64_t)
+ * Rounds an offset up to the next multiple of 8 bytes.
+ */
+inline uint64_t corpus_align(uint64_t offset) {
+    return (offset + 7) & ~(uint64_t) 7;
+}
+
+/**
+ * Function: corpus_layout(uint32_t, uint32_t, uint64_t*)
+ * Computes the offsets of the columns of a block from the beginning of the block.
+ * @param games - games of the block
+ * @param input_bytes - size of the inputs column
+ * @param offsets - receives the offsets of the 6 columns, and the size of the block
+ */
+inline void corpus_layout(uint32_t games, uint32_t input_bytes, uint64_t offsets[7]) {
+    offsets[0] = corpus_align(sizeof(CorpusBlockHeader));
+    offsets[1] = corpus_align(offsets[0] + games * sizeof(uint32_t));
+    offsets[2] = corpus_align(offsets[1] + games * sizeof(uint8_t));
+    offsets[3] = corpus_align(offsets[2] + games * sizeof(uint32_t));
+    offsets[4] = corpus_align(offsets[3] + games * sizeof(uint32_t));
+    offsets[5] = corpus_align(offsets[4] + (games + 1) * sizeof(uint32_t));
+    offsets[6] = corpus_align(offsets[5] + input_bytes);
+}
+
+/* --- Writing --- */
+
+/**
+ * Function: corpus_write_block(CorpusWriter*)
+ * Appends the games buffered by a writer to its file, as a block.
+ * @return bool - whether the block was written
+ */
+inline bool corpus_write_block(CorpusWriter *w) {
+    if (w->games == 0)
+        return true;
+    uint64_t offsets[7];
+    uint32_t input_bytes = w->input_start[w->games];
+    corpus_layout(w->games, input_bytes, offsets);
+
+    const void *columns[6] = { w->seed, w->level, w->laps, w->score, w->input_start, w->inputs };
+    const uint64_t sizes[6] = { w->games * sizeof(uint32_t), w->games, w->games * sizeof(uint32_t),
+                                w->games * sizeof(uint32_t), (w->games + 1) * sizeof(uint32_t), input_bytes };
+    static const uint8_t padding[8] = { 0 };
+
+    CorpusBlockHeader header = { CORPUS_BLOCK_MAGIC, w->games, offsets[6] };
+    bool ok = fwrite(&header, sizeof(header), 1, w->file) == 1;
+    uint64_t offset = sizeof(header);
+    for (int c = 0 ; c < 6 && ok ; c++) {
+        ok = fwrite(padding, 1, offsets[c] - offset, w->file) == offsets[c] - offset
+             && fwrite(columns[c], 1, sizes[c], w->file) == sizes[c];
+        offset = offsets[c] + sizes[c];
+    }
+    ok = ok && fwrite(padding, 1, offsets[6] - offset, w->file) == offsets[6] - offset;
+
+    w->games = 0;
+    w->input_start[0] = 0;
+    return ok;
+}
+
+/**
+ * Function: corpus_create(CorpusWriter*, const char*)
+ * Opens a corpus file to append games to it, creating it if it does not exist.
+ * @return bool - whether the file could be opened, and is a corpus
+ */
+inline bool corpus_create(CorpusWriter *w, const char *path) {
+    w->file = fopen(path, "ab+");
+    if (w->file == NULL)
+        return false;
+    w->games = 0;
+    w->input_start[0] = 0;
+    w->inputs = NULL;
+    w->inputs_capacity = 0;
+
+    CorpusFileHeader header;
+    fseek(w->file, 0, SEEK_END);
+    if (ftell(w->file) == 0) {
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, CORPUS_MAGIC, sizeof(header.magic));
+        header.version = CORPUS_VERSION;
+        if (fwrite(&header, sizeof(header), 1, w->file) != 1) {
+            fclose(w->file);
+            return false;
+        }
+        return true;
+    }
+    rewind(w->file);
+    if (fread(&header, sizeof(header), 1, w->file) != 1 || memcmp(header.magic, CORPUS_MAGIC, 8) != 0
+        || header.version != CORPUS_VERSION) {
+        fclose(w->file);
+        return false;
+    }
+
+    // A block cut short is dropped, so the new blocks follow the last complete one.
+    // A block is at least its aligned header, so a damaged size cannot stall the scan
+    fseek(w->file, 0, SEEK_END);
+    uint64_t size = ftell(w->file), offset = sizeof(header);
+    CorpusBlockHeader block;
+    while (fseek(w->file, offset, SEEK_SET) == 0 && fread(&block, sizeof(block), 1, w->file) == 1
+           && block.magic == CORPUS_BLOCK_MAGIC && block.size >= corpus_align(sizeof(block))
+           && block.size <= size - offset)
+        offset += block.size;
+    if (offset < size && ftruncate(fileno(w->file), offset) != 0) {
+        fclose(w->file);
+        return false;
+    }
+    fseek(w->file, 0, SEEK_END);
+    return true;
+}
+
+/**
+ * Function: corpus_add(CorpusWriter*, uint32_t, uint8_t, uint32_t, const uint8_t*)
+ * Adds a game to the block being filled, writing the block once it is full.
+ * @param poses - pose of the player at each of the 'laps' game steps (CORPUS_INPUT_*)
+ * @return bool - false if a block could not be written
+ */
+inline bool corpus_add(CorpusWriter *w, uint32_t seed, uint8_t level, uint32_t laps, const uint8_t *poses) {
+    uint32_t start = w->input_start[w->games];
+    uint32_t bytes = (laps + 3) / 4;
+    if (start + bytes > w->inputs_capacity) {
+        w->inputs_capacity = (start + bytes) * 2;
+        w->inputs = (uint8_t *) realloc(w->inputs, w->inputs_capacity);
+    }
+    memset(w->inputs + start, 0, bytes);
+    for (uint32_t i = 0 ; i < laps ; i++)
+        w->inputs[start + i / 4] |= (poses[i] & 3) << (2 * (i % 4));
+
+    w->seed[w->games] = seed;
+    w->level[w->games] = level;
+    w->laps[w->games] = laps;
+    w->score[w->games] = laps * level;
+    w->games++;
+    w->input_start[w->games] = start + bytes;
+    return w->games < CORPUS_BLOCK_GAMES || corpus_write_block(w);
+}
+
+/**
+ * Function: corpus_finish(CorpusWriter*)
+ * Writes the last block and closes the file.
+ * @return bool - whether everything was written
+ */
+inline bool corpus_finish(CorpusWriter *w) {
+    bool ok = corpus_write_block(w);
+    ok = fclose(w->file) == 0 && ok;
+    free(w->inputs);
+    return ok;
+}
+
+/* --- Reading --- */
+
+/**
+ * Function: corpus_open(Corpus*, const char*)
+ * Maps a corpus file in memory.
+ * @return bool - whether the file could be mapped, and is a corpus
+ */
+inline bool corpus_open(Corpus *c, const char *path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(CorpusFileHeader)) {
+        close(fd);
+        return false;
+    }
+    void *data = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+        return false;
+    madvise(data, st.st_size, MADV_SEQUENTIAL);
+
+    c->data = (const uint8_t *) data;
+    c->size = st.st_size;
+    c->next = sizeof(CorpusFileHeader);
+    const CorpusFileHeader *header = (const CorpusFileHeader *) data;
+    if (memcmp(header->magic, CORPUS_MAGIC, 8) != 0 || header->version != CORPUS_VERSION) {
+        munmap(data, st.st_size);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Function: corpus_next(Corpus*, CorpusBlock*)
+ * Points to the columns of the next block of a corpus.
+ * @return bool - false once there are no more complete blocks
+ */
+inline bool corpus_next(Corpus *c, CorpusBlock *block) {
+    if (c->next + sizeof(CorpusBlockHeader) > c->size)
+        return false;
+    const uint8_t *base = c->data + c->next;
+    const CorpusBlockHeader *header = (const CorpusBlockHeader *) base;
+    if (header->magic != CORPUS_BLOCK_MAGIC || header->size > c->size - c->next)
+        return false;
+
+    // The size of the inputs column is the last entry of input_start
+    uint64_t offsets[7];
+    corpus_layout(header->games, 0, offsets);
+    if (header->games > CORPUS_BLOCK_GAMES || offsets[6] > header->size)
+        return false;
+    const uint32_t *input_start = (const uint32_t *) (base + offsets[4]);
+    corpus_layout(header->games, input_start[header->games], offsets);
+    if (offsets[6] != header->size)
+        return false;
+
+    block->games = header->games;
+    block->seed = (const uint32_t *) (base + offsets[0]);
+    block->level = base + offsets[1];
+    block->laps = (const uint32_t *) (base + offsets[2]);
+    block->score = (const uint32_t *) (base + offsets[3]);
+    block->input_start = input_start;
+    block->inputs = base + offsets[5];
+    c->next += header->size;
+    return true;
+}
+
+/**
+ * Function: corpus_rewind(Corpus*)
+ * Goes back to the first block.
+ */
+inline void corpus_rewind(Corpus *c) {
+    c->next = sizeof(CorpusFileHeader);
+}
+
+/**
+ * Function: corpus_close(Corpus*)
+ * Unmaps a corpus file.
+ */
+inline void corpus_close(Corpus *c) {
+    munmap((void *) c->data, c->size);
+}
+
+/**
+ * Function: corpus_input(const CorpusBlock*, uint32_t, uint32_t)
+ * Returns the pose of the player at a game step of a game of a block (CORPUS_INPUT_*).
+ */
+inline uint8_t corpus_input(const CorpusBlock *block, uint32_t game, uint32_t step) {
+    return (block->inputs[block->input_start[game] + step / 4] >> (2 * (step % 4))) & 3;
+}
+
+#endif
@@ -0,0 +1,122 @@
+/**
+ * ---- corpus query ----
+ * Reads a corpus of simulated games (see tools/corpus.hpp), as written by tools/lockstep_sim.cpp, and reports how long
+ * the games of a difficulty last : the number of games, their mean laps and score, and a histogram of their laps. The
+ * corpus is mapped in memory and only the columns a query needs are read, straight from the mapping.
+ *
+ * Usage: corpus_query [-d level] [-b width] [-r rows] [-s seed] corpus
+ *   -d level  - only the games of a difficulty level, 1 to 4 (default : every game)
+ *   -b width  - laps per row of the histogram (default 50)
+ *   -r rows   - rows of the histogram, the last one counting every longer game (default 20)
+ *   -s seed   - also prints the poses of the player in the games of a seed : '.' none, '^' jump, 'v' crouch
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "corpus.hpp"
+
+#define BAR_WIDTH 50
+
+static double now_s() {
+    timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+static void print_game(const CorpusBlock *block, uint32_t game) {
+    static const char POSES[4] = { '.', '^', 'v', '?' };
+    printf("seed %lu level %u laps %u score %u\n", (unsigned long) block->seed[game], (unsigned) block->level[game],
+           (unsigned) block->laps[game], (unsigned) block->score[game]);
+    for (uint32_t step = 0 ; step < block->laps[game] ; step++) {
+        putchar(POSES[corpus_input(block, game, step)]);
+        if (step % 100 == 99 || step + 1 == block->laps[game])
+            putchar('\n');
+    }
+}
+
+int main(int argc, char **argv) {
+    int level = 0, rows = 20;
+    uint32_t width = 50;
+    long seed = -1;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "d:b:r:s:")) != -1) {
+        switch (opt) {
+            case 'd': level = atoi(optarg); break;
+            case 'b': width = strtoul(optarg, NULL, 0); break;
+            case 'r': rows = atoi(optarg); break;
+            case 's': seed = strtol(optarg, NULL, 0); break;
+            default:
+                fprintf(stderr, "usage: %s [-d level] [-b width] [-r rows] [-s seed] corpus\n", argv[0]);
+                return 2;
+        }
+    }
+    if (optind + 1 != argc || width < 1 || rows < 1) {
+        fprintf(stderr, "usage: %s [-d level] [-b width] [-r rows] [-s seed] corpus\n", argv[0]);
+        return 2;
+    }
+
+    Corpus corpus;
+    if (!corpus_open(&corpus, argv[optind])) {
+        fprintf(stderr, "%s: %s is not a corpus file\n", argv[0], argv[optind]);
+        return 2;
+    }
+
+    uint64_t *histogram = (uint64_t *) calloc(rows, sizeof(uint64_t));
+    uint64_t scanned = 0, matched = 0, total_laps = 0, total_score = 0;
+    uint32_t max_laps = 0;
+
+    double start = now_s();
+    CorpusBlock block;
+    while (corpus_next(&corpus, &block)) {
+        scanned += block.games;
+        for (uint32_t i = 0 ; i < block.games ; i++) {
+            if (level != 0 && block.level[i] != level)
+                continue;
+            uint32_t laps = block.laps[i];
+            matched++;
+            total_laps += laps;
+            total_score += block.score[i];
+            if (laps > max_laps)
+                max_laps = laps;
+            uint32_t row = laps / width;
+            histogram[row < (uint32_t) rows ? row : rows - 1]++;
+        }
+        if (seed >= 0) {
+            for (uint32_t i = 0 ; i < block.games ; i++)
+                if (block.seed[i] == (uint32_t) seed && (level == 0 || block.level[i] == level))
+                    print_game(&block, i);
+        }
+    }
+    double elapsed = now_s() - start;
+
+    printf("games=%llu matched=%llu mean_laps=%.1f mean_score=%.1f max_laps=%u\n", (unsigned long long) scanned,
+           (unsigned long long) matched, matched ? (double) total_laps / matched : 0.0,
+           matched ? (double) total_score / matched : 0.0, (unsigned) max_laps);
+
+    uint64_t highest = 1;
+    for (int row = 0 ; row < rows ; row++)
+        if (histogram[row] > highest)
+            highest = histogram[row];
+    for (int row = 0 ; row < rows ; row++) {
+        char range[32];
+        if (row + 1 < rows)
+            snprintf(range, sizeof(range), "%u-%u", (unsigned) (row * width), (unsigned) ((row + 1) * width - 1));
+        else
+            snprintf(range, sizeof(range), ">=%u", (unsigned) (row * width));
+        printf("%13s %10llu ", range, (unsigned long long) histogram[row]);
+        for (int i = 0 ; i < (int) (histogram[row] * BAR_WIDTH / highest) ; i++)
+            putchar('#');
+        putchar('\n');
+    }
+    printf("scan_s=%.3f games_per_s=%.3g file_mb=%.1f\n", elapsed, scanned / elapsed, corpus.size / 1e6);
+
+    free(histogram);
+    corpus_close(&corpus);
+    return 0;
+}
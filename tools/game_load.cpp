@@ -0,0 +1,281 @@
+/**
+ * ---- game load generator ----
+ * Connects many players to tools/game_server.cpp and measures how late their frames arrive. Every connection is a
+ * player which reads the screen : it presses B4 on the screens waiting for it, and B3 (crouch) or B2 (jump) when an
+ * obstacle is in the column next to it on the top or the bottom line, with a given chance of reacting, so its lives end
+ * and go through every screen of the game.
+ *
+ * A frame carries the time its step was due on the server ; the time from then until the player receives it is its
+ * lateness, which includes the delay of the server's timer wheel, the socket and the player's own loop. The players
+ * are spread over a few threads, each with an epoll loop.
+ *
+ * Usage: game_load [-u path] [-p port] [-n players] [-j threads] [-t seconds] [-k skill]
+ *   -u path     - path of the server's Unix domain socket (default /tmp/dino.sock)
+ *   -p port     - connect to a TCP port of 127.0.0.1 instead
+ *   -n players  - connections (default 1000)
+ *   -j threads  - threads of the players (default 2)
+ *   -t seconds  - duration of the measure, after every player is connected (default 10)
+ *   -k skill    - chances in 256 that a player reacts to an obstacle, 0 to 256 (default 250)
+ *
+ * Exits with 1 if a connection failed or was closed by the server.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include <atomic>
+#include <thread>
+
+#include "../spawn/spawn.hpp"
+#include "game_protocol.hpp"
+
+#define MAX_THREADS 64
+#define MAX_EVENTS 256
+#define INPUT_SIZE 4096
+#define LATE_BUCKETS 100000     // buckets of 1 us of the histogram of the lateness, the last one counting the later frames
+
+/**
+ * Struct: Player
+ * A connection, and the screen it sees.
+ */
+struct Player {
+    int fd;
+    uint8_t state;
+    char screen[GAME_CELLS];
+    SpawnRng rng;               // for the reactions
+    uint8_t input[INPUT_SIZE];
+    uint32_t input_length;
+};
+
+/**
+ * Struct: Worker
+ * A thread of players, and what it measured.
+ */
+struct Worker {
+    Player *players;
+    int count;
+    int epoll;
+    std::thread thread;
+    uint64_t frames, games, laps, failures;
+    uint32_t *late;             // histogram of the lateness, in us
+};
+
+static const char *path = GAME_SOCKET;
+static int port = 0;
+static uint32_t skill = 250;
+static std::atomic<bool> measuring(false), stopping(false);
+
+static uint64_t now_ns() {
+    timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t) t.tv_sec * 1000000000 + t.tv_nsec;
+}
+
+static int connect_server() {
+    int fd;
+    if (port > 0) {
+        sockaddr_in address;
+        memset(&address, 0, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_port = htons(port);
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        if (fd >= 0 && connect(fd, (sockaddr *) &address, sizeof(address)) == 0)
+            return fd;
+    } else {
+        sockaddr_un address;
+        memset(&address, 0, sizeof(address));
+        address.sun_family = AF_UNIX;
+        strncpy(address.sun_path, path, sizeof(address.sun_path) - 1);
+        fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd >= 0 && connect(fd, (sockaddr *) &address, sizeof(address)) == 0)
+            return fd;
+    }
+    if (fd >= 0)
+        close(fd);
+    return -1;
+}
+
+static void press(Player *p, char key) {
+    send(p->fd, &key, 1, MSG_DONTWAIT | MSG_NOSIGNAL);
+}
+
+/**
+ * Handles a message of the server. Returns its size, 0 if it is not complete, or -1 if it is not understood.
+ */
+static long receive(Worker *w, Player *p, const uint8_t *message, size_t length) {
+    size_t size = game_message_size(message, length);
+    if (size == 0 || size == (size_t) -1)
+        return (long) size;
+
+    if (message[0] == GAME_MSG_OVER) {
+        if (measuring.load(std::memory_order_relaxed)) {
+            w->games++;
+            w->laps += game_get32(message + 1);
+        }
+        return (long) size;
+    }
+
+    // GAME_MSG_FRAME
+    uint64_t due_ns = game_get64(message + 6);
+    for (int i = 0 ; i < message[GAME_FRAME_HEADER - 1] ; i++) {
+        uint8_t cell = message[GAME_FRAME_HEADER + 2 * i];
+        if (cell < GAME_CELLS)
+            p->screen[cell] = (char) message[GAME_FRAME_HEADER + 2 * i + 1];
+    }
+    p->state = message[1];
+    if (measuring.load(std::memory_order_relaxed)) {
+        uint64_t now = now_ns(), late_us = now > due_ns ? (now - due_ns) / 1000 : 0;
+        w->late[late_us < LATE_BUCKETS ? late_us : LATE_BUCKETS - 1]++;
+        w->frames++;
+    }
+
+    if (p->state != GAME_STATE_PLAYING) {
+        press(p, '4');
+    } else if (spawn_byte(&p->rng) < skill) {
+        if (p->screen[1] == '-')
+            press(p, '3');
+        else if (p->screen[GAME_COLUMNS + 1] == '-')
+            press(p, '2');
+    }
+    return (long) size;
+}
+
+static void run(Worker *w) {
+    epoll_event events[MAX_EVENTS];
+    while (!stopping.load(std::memory_order_relaxed)) {
+        int n = epoll_wait(w->epoll, events, MAX_EVENTS, 100);
+        for (int i = 0 ; i < n ; i++) {
+            Player *p = (Player *) events[i].data.ptr;
+            ssize_t got = recv(p->fd, p->input + p->input_length, INPUT_SIZE - p->input_length, MSG_DONTWAIT);
+            if (got <= 0) {
+                if (got < 0 && (errno == EAGAIN || errno == EINTR))
+                    continue;
+                epoll_ctl(w->epoll, EPOLL_CTL_DEL, p->fd, NULL);
+                w->failures++;
+                continue;
+            }
+            p->input_length += got;
+
+            uint32_t offset = 0;
+            long size;
+            while ((size = receive(w, p, p->input + offset, p->input_length - offset)) > 0)
+                offset += size;
+            if (size < 0) {
+                epoll_ctl(w->epoll, EPOLL_CTL_DEL, p->fd, NULL);
+                w->failures++;
+                continue;
+            }
+            memmove(p->input, p->input + offset, p->input_length - offset);
+            p->input_length -= offset;
+        }
+    }
+}
+
+int main(int argc, char **argv) {
+    int count = 1000, threads = 2, seconds = 10;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "u:p:n:j:t:k:")) != -1) {
+        switch (opt) {
+            case 'u': path = optarg; break;
+            case 'p': port = atoi(optarg); break;
+            case 'n': count = atoi(optarg); break;
+            case 'j': threads = atoi(optarg); break;
+            case 't': seconds = atoi(optarg); break;
+            case 'k': skill = strtoul(optarg, NULL, 0); break;
+            default:
+                fprintf(stderr, "usage: %s [-u path] [-p port] [-n players] [-j threads] [-t seconds] [-k skill]\n",
+                        argv[0]);
+                return 2;
+        }
+    }
+    if (count < 1 || threads < 1 || threads > MAX_THREADS || seconds < 1 || skill > 256) {
+        fprintf(stderr, "%s: the players and the seconds must be at least 1, the threads 1 to %d, the skill 0 to 256\n",
+                argv[0], MAX_THREADS);
+        return 2;
+    }
+
+    rlimit files;
+    if (getrlimit(RLIMIT_NOFILE, &files) == 0) {
+        files.rlim_cur = files.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &files);
+    }
+
+    // Connect every player first, then start the threads
+    static Worker workers[MAX_THREADS];
+    Player *players = (Player *) calloc(count, sizeof(Player));
+    for (int t = 0 ; t < threads ; t++) {
+        Worker *w = &workers[t];
+        w->players = players + (long) count * t / threads;
+        w->count = (int) ((long) count * (t + 1) / threads - (long) count * t / threads);
+        w->epoll = epoll_create1(EPOLL_CLOEXEC);
+        w->late = (uint32_t *) calloc(LATE_BUCKETS, sizeof(uint32_t));
+        for (int i = 0 ; i < w->count ; i++) {
+            Player *p = &w->players[i];
+            p->fd = connect_server();
+            if (p->fd < 0) {
+                perror("connect");
+                return 1;
+            }
+            memset(p->screen, ' ', GAME_CELLS);
+            spawn_seed(&p->rng, spawn_life_seed(1, (uint16_t) (p - players)));
+            epoll_event ev = { EPOLLIN, { p } };
+            epoll_ctl(w->epoll, EPOLL_CTL_ADD, p->fd, &ev);
+        }
+    }
+    for (int t = 0 ; t < threads ; t++)
+        workers[t].thread = std::thread(run, &workers[t]);
+
+    // Let the players reach the game steps before measuring
+    sleep(1);
+    measuring = true;
+    uint64_t start = now_ns();
+    sleep(seconds);
+    measuring = false;
+    double elapsed = (now_ns() - start) / 1e9;
+    stopping = true;
+
+    uint64_t frames = 0, games = 0, laps = 0, failures = 0;
+    static uint64_t late[LATE_BUCKETS];
+    for (int t = 0 ; t < threads ; t++) {
+        workers[t].thread.join();
+        frames += workers[t].frames;
+        games += workers[t].games;
+        laps += workers[t].laps;
+        failures += workers[t].failures;
+        for (int b = 0 ; b < LATE_BUCKETS ; b++)
+            late[b] += workers[t].late[b];
+    }
+
+    // Percentiles of the lateness
+    const double quantiles[4] = { 0.5, 0.99, 0.999, 1.0 };
+    uint64_t values[4] = { 0, 0, 0, 0 }, seen = 0;
+    int q = 0;
+    for (int b = 0 ; b < LATE_BUCKETS && q < 4 ; b++) {
+        seen += late[b];
+        while (q < 4 && frames > 0 && seen >= quantiles[q] * frames && late[b] > 0)
+            values[q++] = b;
+    }
+
+    printf("players=%d frames_per_s=%.0f games=%llu mean_laps=%.1f late_p50_us=%llu late_p99_us=%llu "
+           "late_p999_us=%llu late_max_us=%llu%s failures=%llu\n", count, frames / elapsed, (unsigned long long) games,
+           games ? (double) laps / games : 0.0, (unsigned long long) values[0], (unsigned long long) values[1],
+           (unsigned long long) values[2], (unsigned long long) values[3],
+           values[3] == LATE_BUCKETS - 1 ? "+" : "", (unsigned long long) failures);
+    return failures > 0 ? 1 : 0;
+}
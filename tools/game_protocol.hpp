@@ -0,0 +1,86 @@
+/**
+ * File: game_protocol.hpp
+ * -----------------------
+ * Messages between tools/game_server.cpp and its clients, such as tools/game_load.cpp.
+ *
+ * A client sends the keys of the board's buttons, one byte each : '1' to '4' for B1 to B4. Any other byte is ignored,
+ * so the game can be played by hand with a raw connection (socat, nc -U, ...).
+ *
+ * The server sends the cells of the 16x2 screen which changed since the previous frame, and the score of every game :
+ *   - GAME_MSG_FRAME : type, state (GAME_STATE_*), step (uint32_t), due_ns (uint64_t), count (uint8_t), then count
+ *                      pairs of the cell (row * GAME_COLUMNS + column) and its character. due_ns is the time of
+ *                      CLOCK_MONOTONIC at which the step was due, so a client on the same host measures how late the
+ *                      frame arrives.
+ *   - GAME_MSG_OVER :  type, laps (uint32_t), score (uint32_t) of a life which just ended.
+ * The integers are little-endian, and the messages are not aligned.
+ */
+
+#ifndef _game_protocol_
+#define _game_protocol_
+
+#include <stdint.h>
+#include <string.h>
+
+#define GAME_COLUMNS 16
+#define GAME_ROWS 2
+#define GAME_CELLS (GAME_COLUMNS * GAME_ROWS)
+
+#define GAME_SOCKET "/tmp/dino.sock" // default path of the server's socket
+
+// Types of the messages of the server
+#define GAME_MSG_FRAME 'F'
+#define GAME_MSG_OVER 'O'
+#define GAME_FRAME_HEADER 15         // bytes of a frame before its cells
+#define GAME_FRAME_MAX (GAME_FRAME_HEADER + 2 * GAME_CELLS)
+#define GAME_OVER_SIZE 9
+
+// Screens of a session, as in main.cpp
+#define GAME_STATE_LIFE 0            // life number, waiting for B4
+#define GAME_STATE_PLAYING 1         // game steps
+#define GAME_STATE_OVER 2            // game over, waiting for B4
+#define GAME_STATE_SCORE 3           // score of the life, waiting for B4
+#define GAME_STATE_TOTAL 4           // total score of the 4 lives, waiting for B4 to start again
+
+inline uint8_t *game_put32(uint8_t *p, uint32_t value) {
+    for (int i = 0 ; i < 4 ; i++)
+        *p++ = (uint8_t) (value >> (8 * i));
+    return p;
+}
+
+inline uint8_t *game_put64(uint8_t *p, uint64_t value) {
+    for (int i = 0 ; i < 8 ; i++)
+        *p++ = (uint8_t) (value >> (8 * i));
+    return p;
+}
+
+inline uint32_t game_get32(const uint8_t *p) {
+    return p[0] | (uint32_t) p[1] << 8 | (uint32_t) p[2] << 16 | (uint32_t) p[3] << 24;
+}
+
+inline uint64_t game_get64(const uint8_t *p) {
+    return game_get32(p) | (uint64_t) game_get32(p + 4) << 32;
+}
+
+/**
+ * Function: game_message_size(const uint8_t*, size_t)
+ * Size of the message at the beginning of a buffer received from the server.
+ * @return size_t - size of the message, 0 if it is not complete yet, or (size_t) -1 if its type is unknown
+ */
+inline size_t game_message_size(const uint8_t *p, size_t length) {
+    if (length == 0)
+        return 0;
+    switch (p[0]) {
+        case GAME_MSG_FRAME: {
+            if (length < GAME_FRAME_HEADER)
+                return 0;
+            size_t size = GAME_FRAME_HEADER + 2u * p[GAME_FRAME_HEADER - 1];
+            return length >= size ? size : 0;
+        }
+        case GAME_MSG_OVER:
+            return length >= GAME_OVER_SIZE ? GAME_OVER_SIZE : 0;
+        default:
+            return (size_t) -1;
+    }
+}
+
+#endif
@@ -0,0 +1,634 @@
+/**
+ * ---- game server ----
+ * Hosts many sessions of the game at once on one Linux machine. A client connects to a Unix domain socket (or to a
+ * TCP port of the loopback), sends the keys of the buttons and receives the cells of the screen which changed, with
+ * the messages of tools/game_protocol.hpp.
+ *
+ * A session goes through the screens of game() in main.cpp : the life number, the game steps, the game over and the
+ * score of the life, and the total score once the 4 lives are lost. A game step is played the same way : the obstacles
+ * come one column closer, the random stream of spawn/spawn.hpp decides the new one, the pose of the player comes from
+ * the last of B2 or B3 pressed since the previous step, and the obstacle at column 0 ends the life if the pose does not
+ * avoid it. The difficulty and the delay between two steps are chosen by the value of the potentiometer, as on the
+ * board.
+ *
+ * The sessions are spread over shards, one thread each. A shard runs an epoll loop over its clients, and a timer wheel
+ * of 1 ms slots for the next step of every session : a timerfd wakes the loop every millisecond, which plays the steps
+ * which are due. A session only sends the cells which changed, in one write per step.
+ *
+ * Every interval, the server prints the sessions, the steps played per second, how late the steps were played and the
+ * CPU time of the shards, from which it extrapolates the sessions a core could serve.
+ *
+ * Usage: game_server [-u path] [-p port] [-j shards] [-a adc] [-s seed] [-i interval_s]
+ *   -u path      - path of the Unix domain socket (default /tmp/dino.sock)
+ *   -p port      - listen on a TCP port of 127.0.0.1 instead
+ *   -j shards    - threads serving the sessions (default : one per core)
+ *   -a adc       - value of the potentiometer, choosing the difficulty and the delay between steps (default 100)
+ *   -s seed      - seed of the run (default : the time)
+ *   -i seconds   - interval between two reports (default 5)
+ */
+
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <sys/un.h>
+
+#include <atomic>
+#include <thread>
+
+#include "../difficulty/difficulty.hpp"
+#include "../spawn/spawn.hpp"
+#include "game_protocol.hpp"
+
+#define MAX_SHARDS 256
+#define MAX_LIVES 4
+#define WHEEL_SLOTS 1024        // slots of 1 ms of the timer wheel (a power of 2)
+#define OUTPUT_SIZE 2048        // bytes waiting to be sent to a client, at most : a slower client is dropped
+#define MAX_EVENTS 256
+#define ACCEPT_BATCH 8          // connections accepted per wake-up, so they spread over the shards
+
+/**
+ * Struct: Session
+ * A client, and the game it plays.
+ */
+struct Session {
+    int fd;
+    uint8_t state;              // GAME_STATE_*
+
+    // Game, as in main.cpp
+    SpawnQueue queue;
+    uint32_t top, bottom;       // obstacles : bit x set if an obstacle is at column x of the line
+    uint8_t key;                // '2' or '3' if B2 or B3 was pressed since the previous step, else 0
+    uint8_t step;               // position of the legs
+    bool step_up;
+    uint32_t lap, score;
+    uint8_t lives;
+
+    // Timer wheel
+    uint64_t due_ms;            // slot of the next step, while playing
+    Session *prev, *next;
+    bool scheduled;
+
+    // Screen, and the screen last sent to the client
+    char screen[GAME_CELLS];
+    char sent[GAME_CELLS];
+
+    uint8_t output[OUTPUT_SIZE];
+    uint32_t output_length;
+    bool writable;              // whether the socket took every byte, else EPOLLOUT is watched
+    bool closed;                // freed after the events of the current wake-up, which may still name it
+};
+
+/**
+ * Struct: Shard
+ * A thread serving its sessions.
+ */
+struct Shard {
+    int index;
+    int epoll, timer;
+    uint64_t now_ms;            // last slot of the wheel played
+    Session *wheel[WHEEL_SLOTS];
+    Session *closed;            // sessions closed during the current wake-up, linked by next
+    uint16_t lives_started;     // for the seeds of the lives
+    std::thread thread;
+
+    // Statistics, read by the main thread
+    std::atomic<uint32_t> sessions;
+    std::atomic<uint64_t> steps, late_ns, late_max_ns;
+};
+
+static int listener;
+static uint64_t start_ns;       // time of slot 0 of the wheels
+static uint32_t run_seed;
+static uint8_t level, threshold;
+static uint32_t period_ms;
+static Shard shards[MAX_SHARDS];
+static volatile sig_atomic_t stopping = 0;
+
+static uint64_t now_ns() {
+    timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t) t.tv_sec * 1000000000 + t.tv_nsec;
+}
+
+/* --- Timer wheel --- */
+
+static void wheel_remove(Shard *sh, Session *s) {
+    if (!s->scheduled)
+        return;
+    if (s->prev != NULL)
+        s->prev->next = s->next;
+    else
+        sh->wheel[s->due_ms & (WHEEL_SLOTS - 1)] = s->next;
+    if (s->next != NULL)
+        s->next->prev = s->prev;
+    s->scheduled = false;
+}
+
+static void wheel_add(Shard *sh, Session *s, uint64_t due_ms) {
+    Session **slot = &sh->wheel[due_ms & (WHEEL_SLOTS - 1)];
+    s->due_ms = due_ms;
+    s->prev = NULL;
+    s->next = *slot;
+    if (*slot != NULL)
+        (*slot)->prev = s;
+    *slot = s;
+    s->scheduled = true;
+}
+
+/* --- Output --- */
+
+static void session_close(Shard *sh, Session *s) {
+    if (s->closed)
+        return;
+    wheel_remove(sh, s);
+    epoll_ctl(sh->epoll, EPOLL_CTL_DEL, s->fd, NULL);
+    close(s->fd);
+    s->closed = true;
+    s->next = sh->closed;
+    sh->closed = s;
+    sh->sessions.fetch_sub(1, std::memory_order_relaxed);
+}
+
+/**
+ * Sends what the client has not received yet. Returns false if the session was closed.
+ */
+static bool session_flush(Shard *sh, Session *s) {
+    while (s->output_length > 0) {
+        ssize_t n = send(s->fd, s->output, s->output_length, MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (n > 0) {
+            memmove(s->output, s->output + n, s->output_length - n);
+            s->output_length -= n;
+        } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            if (s->writable) {
+                epoll_event ev = { EPOLLIN | EPOLLOUT, { s } };
+                epoll_ctl(sh->epoll, EPOLL_CTL_MOD, s->fd, &ev);
+                s->writable = false;
+            }
+            return true;
+        } else if (n < 0 && errno == EINTR) {
+            continue;
+        } else {
+            session_close(sh, s);
+            return false;
+        }
+    }
+    if (!s->writable) {
+        epoll_event ev = { EPOLLIN, { s } };
+        epoll_ctl(sh->epoll, EPOLL_CTL_MOD, s->fd, &ev);
+        s->writable = true;
+    }
+    return true;
+}
+
+/**
+ * Queues a message for the client. Returns false if the client is too far behind : the session must be closed.
+ */
+static bool session_queue(Session *s, const uint8_t *message, uint32_t size) {
+    if (s->output_length + size > OUTPUT_SIZE)
+        return false;
+    memcpy(s->output + s->output_length, message, size);
+    s->output_length += size;
+    return true;
+}
+
+/**
+ * Queues the cells of the screen which changed since the previous frame.
+ */
+static bool session_frame(Session *s, uint64_t due_ns) {
+    uint8_t message[GAME_FRAME_MAX];
+    uint8_t *p = message + GAME_FRAME_HEADER;
+    for (int cell = 0 ; cell < GAME_CELLS ; cell++) {
+        if (s->screen[cell] != s->sent[cell]) {
+            *p++ = (uint8_t) cell;
+            *p++ = (uint8_t) s->screen[cell];
+            s->sent[cell] = s->screen[cell];
+        }
+    }
+    uint8_t count = (uint8_t) ((p - message - GAME_FRAME_HEADER) / 2);
+    if (count == 0)
+        return true;
+
+    message[0] = GAME_MSG_FRAME;
+    message[1] = s->state;
+    game_put64(game_put32(message + 2, s->lap), due_ns);
+    message[GAME_FRAME_HEADER - 1] = count;
+    return session_queue(s, message, p - message);
+}
+
+/* --- Game --- */
+
+static void show(Session *s, const char *top, const char *bottom) {
+    memset(s->screen, ' ', GAME_CELLS);
+    memcpy(s->screen, top, strnlen(top, GAME_COLUMNS));
+    memcpy(s->screen + GAME_COLUMNS, bottom, strnlen(bottom, GAME_COLUMNS));
+}
+
+/**
+ * Shows the screen of the current state, other than the game steps.
+ */
+static void show_state(Session *s) {
+    char line[GAME_COLUMNS + 8];
+    switch (s->state) {
+        case GAME_STATE_LIFE:
+            snprintf(line, sizeof(line), "*  Life : %d/4  *", MAX_LIVES - s->lives + 1);
+            show(s, line, "*--*---**---*--*");
+            break;
+        case GAME_STATE_OVER:
+            show(s, "** GAME  OVER **", "****************");
+            break;
+        case GAME_STATE_SCORE:
+            snprintf(line, sizeof(line), "    %u pts", (unsigned) (s->lap * level));
+            show(s, "*    Score    *", line);
+            break;
+        case GAME_STATE_TOTAL:
+            snprintf(line, sizeof(line), "    %u pts", (unsigned) s->score);
+            show(s, "* Total Score *", line);
+            break;
+    }
+}
+
+/**
+ * Draws a game step : the obstacles, and the player with the obstacle reaching them, as disp_player_column().
+ */
+static void show_step(Session *s, bool jumping, bool crouching) {
+    for (int x = 1 ; x < GAME_COLUMNS ; x++) {
+        s->screen[x] = (s->top >> x) & 1 ? '-' : ' ';
+        s->screen[GAME_COLUMNS + x] = (s->bottom >> x) & 1 ? '-' : ' ';
+    }
+    char top = jumping || !crouching ? 'o' : ' ';
+    char bottom = crouching ? 'o' : jumping ? ' ' : (s->step == 1 ? '|' : '>');
+    if (s->top & 1)
+        top = crouching ? '-' : 'x';
+    if (s->bottom & 1)
+        bottom = jumping ? '-' : 'X';
+    s->screen[0] = top;
+    s->screen[GAME_COLUMNS] = bottom;
+}
+
+static void start_life(Shard *sh, Session *s) {
+    s->state = GAME_STATE_PLAYING;
+    s->top = s->bottom = 0;
+    s->key = 0;
+    s->step = 0;
+    s->step_up = true;
+    s->lap = 0;
+    spawn_queue_init(&s->queue, spawn_life_seed(run_seed + sh->index, sh->lives_started++), threshold);
+    spawn_queue_fill(&s->queue);
+    show_step(s, false, false);
+    wheel_add(sh, s, sh->now_ms + period_ms);
+}
+
+/**
+ * Plays a game step of a session, as game() in main.cpp. Returns false if the session was closed.
+ */
+static bool play_step(Shard *sh, Session *s, uint64_t due_ns) {
+    // update_obstacles, generate_obstacle
+    s->top >>= 1;
+    s->bottom >>= 1;
+    int8_t line = spawn_queue_pop(&s->queue);
+    if (line == 0)
+        s->top |= 1UL << SPAWN_X;
+    else if (line == 1)
+        s->bottom |= 1UL << SPAWN_X;
+
+    // The buttons pressed since the previous step
+    bool jumping = s->key == '2', crouching = s->key == '3';
+    s->key = 0;
+    show_step(s, jumping, crouching);
+
+    // update_step
+    s->lap++;
+    s->step = s->step_up ? s->step + 1 : s->step - 1;
+    if (s->step == 2)
+        s->step_up = false;
+    else if (s->step == 0)
+        s->step_up = true;
+
+    // check_if_game_over
+    bool ok = session_frame(s, due_ns);
+    if (((s->top & 1) && !crouching) || ((s->bottom & 1) && !jumping)) {
+        s->score += s->lap * level;
+        uint8_t over[GAME_OVER_SIZE] = { GAME_MSG_OVER };
+        game_put32(game_put32(over + 1, s->lap), s->lap * level);
+        s->state = GAME_STATE_OVER;
+        show_state(s);
+        ok = ok && session_queue(s, over, sizeof(over)) && session_frame(s, due_ns);
+    } else {
+        spawn_queue_fill(&s->queue);
+        wheel_add(sh, s, s->due_ms + period_ms);
+    }
+
+    if (!ok) {
+        session_close(sh, s);
+        return false;
+    }
+    return session_flush(sh, s);
+}
+
+/**
+ * Handles a key of the client. B4 moves on from the screens waiting for it, as wait(B4) does.
+ */
+static void press(Shard *sh, Session *s, uint8_t key) {
+    if (key == '2' || key == '3') {
+        if (s->state == GAME_STATE_PLAYING)
+            s->key = key;
+        return;
+    }
+    if (key != '4')
+        return;
+
+    switch (s->state) {
+        case GAME_STATE_LIFE:
+            start_life(sh, s);
+            return;
+        case GAME_STATE_OVER:
+            s->state = GAME_STATE_SCORE;
+            break;
+        case GAME_STATE_SCORE:
+            s->lives--;
+            s->state = s->lives > 0 ? GAME_STATE_LIFE : GAME_STATE_TOTAL;
+            break;
+        case GAME_STATE_TOTAL:
+            s->lives = MAX_LIVES;
+            s->score = 0;
+            s->state = GAME_STATE_LIFE;
+            break;
+        default:
+            return;
+    }
+    show_state(s);
+}
+
+/* --- Event loop --- */
+
+static void accept_clients(Shard *sh) {
+    for (int i = 0 ; i < ACCEPT_BATCH ; i++) {
+        int fd = accept4(listener, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0)
+            return;
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one)); // fails harmlessly on a Unix socket
+
+        Session *s = (Session *) calloc(1, sizeof(Session));
+        s->fd = fd;
+        s->lives = MAX_LIVES;
+        s->state = GAME_STATE_LIFE;
+        s->writable = true;
+        memset(s->sent, ' ', GAME_CELLS);
+        show_state(s);
+        epoll_event ev = { EPOLLIN, { s } };
+        if (epoll_ctl(sh->epoll, EPOLL_CTL_ADD, fd, &ev) != 0) {
+            close(fd);
+            free(s);
+            continue;
+        }
+        sh->sessions.fetch_add(1, std::memory_order_relaxed);
+        if (session_frame(s, now_ns()))
+            session_flush(sh, s);
+        else
+            session_close(sh, s);
+    }
+}
+
+static void read_client(Shard *sh, Session *s) {
+    uint8_t keys[64];
+    ssize_t n = recv(s->fd, keys, sizeof(keys), MSG_DONTWAIT);
+    if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+        session_close(sh, s);
+        return;
+    }
+    uint8_t state = s->state;
+    for (ssize_t i = 0 ; i < n ; i++)
+        press(sh, s, keys[i]);
+    if (s->state != state) {
+        if (session_frame(s, now_ns()))
+            session_flush(sh, s);
+        else
+            session_close(sh, s);
+    }
+}
+
+/**
+ * Plays the steps of every slot of the wheel up to the current time.
+ */
+static void run_wheel(Shard *sh) {
+    uint64_t now = now_ns();
+    uint64_t target = (now - start_ns) / 1000000;
+    while (sh->now_ms < target) {
+        sh->now_ms++;
+        Session *s = sh->wheel[sh->now_ms & (WHEEL_SLOTS - 1)], *next;
+        for ( ; s != NULL ; s = next) {
+            next = s->next;
+            if (s->due_ms != sh->now_ms)
+                continue; // a later turn of the wheel
+            wheel_remove(sh, s);
+            uint64_t due_ns = start_ns + s->due_ms * 1000000;
+            uint64_t late = now_ns() - due_ns;
+            sh->steps.fetch_add(1, std::memory_order_relaxed);
+            sh->late_ns.fetch_add(late, std::memory_order_relaxed);
+            if (late > sh->late_max_ns.load(std::memory_order_relaxed))
+                sh->late_max_ns.store(late, std::memory_order_relaxed);
+            play_step(sh, s, due_ns);
+        }
+    }
+}
+
+static void serve(Shard *sh) {
+    epoll_event events[MAX_EVENTS];
+    for (;;) {
+        int n = epoll_wait(sh->epoll, events, MAX_EVENTS, -1);
+        for (int i = 0 ; i < n ; i++) {
+            void *ptr = events[i].data.ptr;
+            if (ptr == &listener) {
+                accept_clients(sh);
+            } else if (ptr == &sh->timer) {
+                uint64_t expirations;
+                if (read(sh->timer, &expirations, sizeof(expirations)) > 0)
+                    run_wheel(sh);
+            } else {
+                Session *s = (Session *) ptr;
+                if (s->closed)
+                    continue;
+                if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+                    session_close(sh, s);
+                    continue;
+                }
+                if ((events[i].events & EPOLLOUT) && !session_flush(sh, s))
+                    continue;
+                if (events[i].events & EPOLLIN)
+                    read_client(sh, s);
+            }
+        }
+        while (sh->closed != NULL) {
+            Session *s = sh->closed;
+            sh->closed = s->next;
+            free(s);
+        }
+    }
+}
+
+static bool start_shard(Shard *sh, int index) {
+    sh->index = index;
+    sh->epoll = epoll_create1(EPOLL_CLOEXEC);
+    sh->timer = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (sh->epoll < 0 || sh->timer < 0)
+        return false;
+
+    // Every millisecond, from slot 0 of the wheel
+    itimerspec period = { { 0, 1000000 }, { (time_t) (start_ns / 1000000000), (long) (start_ns % 1000000000) } };
+    timerfd_settime(sh->timer, TFD_TIMER_ABSTIME, &period, NULL);
+
+    epoll_event ev = { EPOLLIN | EPOLLEXCLUSIVE, { &listener } };
+    if (epoll_ctl(sh->epoll, EPOLL_CTL_ADD, listener, &ev) != 0)
+        return false;
+    ev.events = EPOLLIN;
+    ev.data.ptr = &sh->timer;
+    if (epoll_ctl(sh->epoll, EPOLL_CTL_ADD, sh->timer, &ev) != 0)
+        return false;
+    sh->thread = std::thread(serve, sh);
+    return true;
+}
+
+/* --- Setup --- */
+
+static int listen_unix(const char *path) {
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, path, sizeof(address.sun_path) - 1);
+    unlink(path);
+    if (fd < 0 || bind(fd, (sockaddr *) &address, sizeof(address)) != 0 || listen(fd, SOMAXCONN) != 0)
+        return -1;
+    return fd;
+}
+
+static int listen_tcp(int port) {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (fd < 0 || bind(fd, (sockaddr *) &address, sizeof(address)) != 0 || listen(fd, SOMAXCONN) != 0)
+        return -1;
+    return fd;
+}
+
+static double cpu_s(Shard *sh) {
+    clockid_t clock;
+    timespec t;
+    if (pthread_getcpuclockid(sh->thread.native_handle(), &clock) != 0 || clock_gettime(clock, &t) != 0)
+        return 0;
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+static void on_signal(int) {
+    stopping = 1;
+}
+
+int main(int argc, char **argv) {
+    const char *path = GAME_SOCKET;
+    int port = 0, count = (int) std::thread::hardware_concurrency(), adc = 100, interval = 5;
+    run_seed = (uint32_t) time(NULL);
+
+    int opt;
+    while ((opt = getopt(argc, argv, "u:p:j:a:s:i:")) != -1) {
+        switch (opt) {
+            case 'u': path = optarg; break;
+            case 'p': port = atoi(optarg); break;
+            case 'j': count = atoi(optarg); break;
+            case 'a': adc = atoi(optarg); break;
+            case 's': run_seed = strtoul(optarg, NULL, 0); break;
+            case 'i': interval = atoi(optarg); break;
+            default:
+                fprintf(stderr, "usage: %s [-u path] [-p port] [-j shards] [-a adc] [-s seed] [-i interval_s]\n",
+                        argv[0]);
+                return 2;
+        }
+    }
+    if (count < 1 || count > MAX_SHARDS || adc < 0 || adc > 1023 || interval < 1) {
+        fprintf(stderr, "%s: the shards must be 1 to %d, the ADC value 0 to 1023 and the interval at least 1 s\n",
+                argv[0], MAX_SHARDS);
+        return 2;
+    }
+
+    // The difficulty screen of main.cpp
+    const Difficulty &d = difficulty_for(adc);
+    level = d.level;
+    threshold = d.spawn_threshold;
+    period_ms = adc;
+    if (period_ms == 0)
+        period_ms = 1; // a slot of the wheel
+
+    // A descriptor per client
+    rlimit files;
+    if (getrlimit(RLIMIT_NOFILE, &files) == 0) {
+        files.rlim_cur = files.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &files);
+    }
+
+    listener = port > 0 ? listen_tcp(port) : listen_unix(path);
+    if (listener < 0) {
+        perror(port > 0 ? "listen" : path);
+        return 2;
+    }
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+    signal(SIGPIPE, SIG_IGN);
+
+    start_ns = (now_ns() / 1000000 + 1) * 1000000;
+    for (int i = 0 ; i < count ; i++) {
+        if (!start_shard(&shards[i], i)) {
+            perror("shard");
+            return 2;
+        }
+    }
+    printf("listening on %s, shards=%d level=%u step_ms=%u\n", port > 0 ? "127.0.0.1" : path, count,
+           (unsigned) level, (unsigned) period_ms);
+    fflush(stdout);
+
+    double last_cpu = 0, last_time = now_ns() / 1e9;
+    uint64_t last_steps = 0;
+    while (!stopping) {
+        sleep(interval);
+        uint32_t sessions = 0;
+        uint64_t steps = 0, late = 0, late_max = 0;
+        double cpu = 0;
+        for (int i = 0 ; i < count ; i++) {
+            sessions += shards[i].sessions.load(std::memory_order_relaxed);
+            steps += shards[i].steps.load(std::memory_order_relaxed);
+            late += shards[i].late_ns.exchange(0, std::memory_order_relaxed);
+            uint64_t m = shards[i].late_max_ns.exchange(0, std::memory_order_relaxed);
+            late_max = m > late_max ? m : late_max;
+            cpu += cpu_s(&shards[i]);
+        }
+        double now = now_ns() / 1e9, cores = (cpu - last_cpu) / (now - last_time);
+        printf("sessions=%u steps_per_s=%.0f late_mean_us=%.1f late_max_us=%.1f cores=%.3f sessions_per_core=%.0f\n",
+               (unsigned) sessions, (steps - last_steps) / (now - last_time),
+               steps > last_steps ? late / 1e3 / (steps - last_steps) : 0.0, late_max / 1e3, cores,
+               cores > 0 ? sessions / cores : 0.0);
+        fflush(stdout);
+        last_cpu = cpu;
+        last_time = now;
+        last_steps = steps;
+    }
+
+    if (port == 0)
+        unlink(path);
+    _exit(0); // the shards never return
+}
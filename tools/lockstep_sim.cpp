@@ -0,0 +1,413 @@
+/**
+ * ---- lockstep simulator ----
+ * Plays many games of a difficulty at once on the host, to measure how long a life lasts for a player of a given skill,
+ * and how many games per second the host gets through.
+ *
+ * A game is replayed exactly as game() in main.cpp : every step moves the obstacles one column closer and drops the
+ * one leaving column 0 (update_obstacles), takes the decision of the random stream of spawn/spawn.hpp for the step
+ * (generate_obstacle), lets the player press a button, counts the lap and checks the obstacle at column 0 against the
+ * pose of the player (check_if_game_over). The game's seed is the seed of a life, as sent by the board.
+ *
+ * The player sees the obstacle at column 0 and presses the right button (B2 to jump over a bottom one, B3 to crouch
+ * under a top one) when a random byte is below the skill ; otherwise it does nothing, jumps or crouches at random. Its
+ * random stream is derived from the game's seed, so a game always plays the same way.
+ *
+ * Two paths play the same games and must agree on the laps of every one :
+ *   - scalar : one game at a time, with the vector of obstacles, the spawn queue and the checks of main.cpp ;
+ *   - lockstep : the playfield of a game is two masks of columns, one per line (bit x set if an obstacle is at column
+ *     x), and the games are packed in the 32-bit lanes of SIMD registers (8 per AVX2 register, 4 per SSE2 one). A step
+ *     of every game is a few shifts for the scrolling, ORs for the spawning and ANDs for the collisions, with the
+ *     xorshift32 generators of every lane advanced side by side. A lane whose game is over takes the next game.
+ *
+ * With -o, the games are then played once more by the scalar path, and appended with the poses of the player at every
+ * step to a corpus file (see tools/corpus.hpp), to be queried by tools/corpus_query.cpp.
+ *
+ * Usage: lockstep_sim [-d level] [-s seed] [-n games] [-t steps] [-k skill] [-w registers] [-o corpus]
+ *   -d level      - difficulty level, 1 to 4 (default 4)
+ *   -s seed       - seed of the first game (default 1)
+ *   -n games      - number of games, of consecutive seeds (default 100000)
+ *   -t steps      - laps after which a game is stopped as survived (default 10000)
+ *   -k skill      - chances in 256 that the player presses the right button, 0 to 256 (default 240)
+ *   -w registers  - SIMD registers of games stepped together, 1 to 4 (default 4)
+ *   -o corpus     - corpus file the games are appended to
+ *
+ * Exits with 1 if the two paths disagree on a game.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#include "../difficulty/difficulty.hpp"
+#include "../spawn/spawn.hpp"
+#include "../vector/vector.h"
+#include "corpus.hpp"
+
+#define MAX_REGISTERS 4
+
+// Declared by vector.h, defined by the firmware
+void debug(char *s) {
+    fprintf(stderr, "%s\n", s);
+}
+
+static uint32_t skill = 240;
+
+/**
+ * Returns the seed of the player's random stream in a game.
+ */
+static uint32_t player_seed(uint32_t seed) {
+    return spawn_life_seed(seed, 0xFFFF);
+}
+
+/* --- Scalar path --- */
+
+/**
+ * Class: Obstacle
+ * Same obstacle as in main.cpp.
+ */
+struct Obstacle {
+    int posx;
+    int posy;
+};
+
+static bool move_obstacle(void *elemAddr, void *) {
+    Obstacle *obs = static_cast<Obstacle *>(elemAddr);
+    obs->posx--;
+    return obs->posx < 0;
+}
+
+/**
+ * Plays a game one step at a time, the way game() in main.cpp does. Returns the number of laps of the game, and stores
+ * the pose of the player at every lap into 'poses' if it is not NULL.
+ */
+static uint32_t play_scalar(uint32_t seed, uint8_t threshold, uint32_t steps, uint8_t *poses = NULL) {
+    alignas(__BIGGEST_ALIGNMENT__) static char storage[SPAWN_MAX_OBSTACLES * sizeof(Obstacle)];
+    static VectorArena arena;
+    VectorArenaInit(&arena, storage, sizeof(storage));
+    VectorAllocator allocator = VectorArenaAllocator(&arena);
+    vector obstacles;
+    VectorNewWith(&obstacles, sizeof(Obstacle), NULL, SPAWN_MAX_OBSTACLES, &allocator, 0);
+
+    SpawnQueue queue;
+    spawn_queue_init(&queue, seed, threshold);
+    spawn_queue_fill(&queue);
+    SpawnRng player;
+    spawn_seed(&player, player_seed(seed));
+
+    uint32_t lap = 0;
+    while (lap < steps) {
+        VectorRemoveIf(&obstacles, move_obstacle, NULL);
+
+        int8_t line = spawn_queue_pop(&queue);
+        if (line >= 0) {
+            Obstacle obs = { SPAWN_X, line };
+            VectorAppend(&obstacles, &obs);
+        }
+
+        // The player looks at column 0, where the oldest obstacle is
+        Obstacle *first = VectorLength(&obstacles) > 0 ? (Obstacle *) VectorNth(&obstacles, 0) : NULL;
+        bool top = first != NULL && first->posx == 0 && first->posy == 0;
+        bool bottom = first != NULL && first->posx == 0 && first->posy == 1;
+        bool right = spawn_byte(&player) < skill;
+        uint8_t random_pose = (player.state >> 16) & 3;
+        bool jumping = right ? bottom : random_pose == 1;
+        bool crouching = right ? top : random_pose == 2;
+        if (poses != NULL)
+            poses[lap] = jumping ? CORPUS_INPUT_JUMP : crouching ? CORPUS_INPUT_CROUCH : CORPUS_INPUT_NONE;
+
+        lap++;
+        if ((top && !crouching) || (bottom && !jumping))
+            break;
+        spawn_queue_fill(&queue);
+    }
+    return lap;
+}
+
+/* --- Lockstep path --- */
+
+#if defined(__AVX2__)
+typedef __m256i Lanes;
+#define LANES 8
+#define ISA "avx2"
+static inline Lanes lanes_load(const uint32_t *p) { return _mm256_loadu_si256((const Lanes *) p); }
+static inline void lanes_store(uint32_t *p, Lanes a) { _mm256_storeu_si256((Lanes *) p, a); }
+static inline Lanes lanes_set(uint32_t x) { return _mm256_set1_epi32((int) x); }
+static inline Lanes lanes_and(Lanes a, Lanes b) { return _mm256_and_si256(a, b); }
+static inline Lanes lanes_andnot(Lanes a, Lanes b) { return _mm256_andnot_si256(a, b); } // ~a & b
+static inline Lanes lanes_or(Lanes a, Lanes b) { return _mm256_or_si256(a, b); }
+static inline Lanes lanes_xor(Lanes a, Lanes b) { return _mm256_xor_si256(a, b); }
+static inline Lanes lanes_sub(Lanes a, Lanes b) { return _mm256_sub_epi32(a, b); }
+static inline Lanes lanes_shl(Lanes a, int n) { return _mm256_slli_epi32(a, n); }
+static inline Lanes lanes_shr(Lanes a, int n) { return _mm256_srli_epi32(a, n); }
+static inline Lanes lanes_eq(Lanes a, Lanes b) { return _mm256_cmpeq_epi32(a, b); }
+static inline Lanes lanes_gt(Lanes a, Lanes b) { return _mm256_cmpgt_epi32(a, b); } // signed
+static inline Lanes lanes_select(Lanes mask, Lanes a, Lanes b) { return _mm256_blendv_epi8(b, a, mask); }
+static inline bool lanes_any(Lanes mask) { return !_mm256_testz_si256(mask, mask); }
+#elif defined(__SSE2__)
+typedef __m128i Lanes;
+#define LANES 4
+#define ISA "sse2"
+static inline Lanes lanes_load(const uint32_t *p) { return _mm_loadu_si128((const Lanes *) p); }
+static inline void lanes_store(uint32_t *p, Lanes a) { _mm_storeu_si128((Lanes *) p, a); }
+static inline Lanes lanes_set(uint32_t x) { return _mm_set1_epi32((int) x); }
+static inline Lanes lanes_and(Lanes a, Lanes b) { return _mm_and_si128(a, b); }
+static inline Lanes lanes_andnot(Lanes a, Lanes b) { return _mm_andnot_si128(a, b); } // ~a & b
+static inline Lanes lanes_or(Lanes a, Lanes b) { return _mm_or_si128(a, b); }
+static inline Lanes lanes_xor(Lanes a, Lanes b) { return _mm_xor_si128(a, b); }
+static inline Lanes lanes_sub(Lanes a, Lanes b) { return _mm_sub_epi32(a, b); }
+static inline Lanes lanes_shl(Lanes a, int n) { return _mm_slli_epi32(a, n); }
+static inline Lanes lanes_shr(Lanes a, int n) { return _mm_srli_epi32(a, n); }
+static inline Lanes lanes_eq(Lanes a, Lanes b) { return _mm_cmpeq_epi32(a, b); }
+static inline Lanes lanes_gt(Lanes a, Lanes b) { return _mm_cmpgt_epi32(a, b); } // signed
+static inline Lanes lanes_select(Lanes mask, Lanes a, Lanes b) { return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b)); }
+static inline bool lanes_any(Lanes mask) { return _mm_movemask_epi8(mask) != 0; }
+#else
+#error "The lockstep path needs SSE2 or AVX2"
+#endif
+
+static inline Lanes lanes_xorshift(Lanes x) {
+    x = lanes_xor(x, lanes_shl(x, 13));
+    x = lanes_xor(x, lanes_shr(x, 17));
+    return lanes_xor(x, lanes_shl(x, 5));
+}
+
+/**
+ * Struct: Games
+ * Games being played, one per lane, as arrays of lanes so that any number of registers can be stepped together.
+ * @public top, bottom - columns of the obstacles on each line
+ * @public count - number of obstacles
+ * @public spawn, player - states of the random streams of the obstacles and of the player
+ * @public laps - laps of the game
+ * @public game - index of the game, or -1 if the lane has no more game to play
+ */
+struct Games {
+    uint32_t top[MAX_REGISTERS * LANES];
+    uint32_t bottom[MAX_REGISTERS * LANES];
+    uint32_t count[MAX_REGISTERS * LANES];
+    uint32_t spawn[MAX_REGISTERS * LANES];
+    uint32_t player[MAX_REGISTERS * LANES];
+    uint32_t laps[MAX_REGISTERS * LANES];
+    int32_t game[MAX_REGISTERS * LANES];
+};
+
+static void start_game(Games *g, int lane, int32_t game, uint32_t seed) {
+    SpawnRng rng;
+    g->top[lane] = g->bottom[lane] = g->count[lane] = g->laps[lane] = 0;
+    spawn_seed(&rng, seed);
+    g->spawn[lane] = rng.state;
+    spawn_seed(&rng, player_seed(seed));
+    g->player[lane] = rng.state;
+    g->game[lane] = game;
+}
+
+/**
+ * Plays one step of the games of a register. Returns the mask of the lanes whose game is over.
+ */
+static inline Lanes step_lanes(Games *g, int base, Lanes threshold, Lanes right_max, Lanes steps) {
+    const Lanes one = lanes_set(1), zero = lanes_set(0);
+
+    Lanes top = lanes_load(g->top + base), bottom = lanes_load(g->bottom + base);
+    Lanes count = lanes_load(g->count + base);
+    Lanes spawn = lanes_load(g->spawn + base), player = lanes_load(g->player + base);
+
+    // update_obstacles : the obstacle at column 0 goes away, the others come one column closer
+    count = lanes_sub(count, lanes_and(lanes_or(top, bottom), one));
+    top = lanes_shr(top, 1);
+    bottom = lanes_shr(bottom, 1);
+
+    // generate_obstacle : spawn_next with spawn_allowed, drawing one random byte, and a second one for the line
+    Lanes near = lanes_and(lanes_or(top, bottom), lanes_set(~0U << (SPAWN_X - SPAWN_MIN_GAP + 1)));
+    Lanes allowed = lanes_and(lanes_gt(lanes_set(SPAWN_MAX_OBSTACLES), count), lanes_eq(near, zero));
+    Lanes first = lanes_xorshift(spawn), second = lanes_xorshift(first);
+    Lanes spawned = lanes_and(allowed, lanes_gt(lanes_shr(first, 24), threshold));
+    spawn = lanes_select(allowed, lanes_select(spawned, second, first), spawn);
+    Lanes on_bottom = lanes_eq(lanes_and(lanes_shr(second, 24), one), one);
+    Lanes column = lanes_and(spawned, lanes_set(1UL << SPAWN_X));
+    top = lanes_or(top, lanes_andnot(on_bottom, column));
+    bottom = lanes_or(bottom, lanes_and(on_bottom, column));
+    count = lanes_sub(count, spawned);
+
+    // The player : the right button when its random byte is below the skill, a random pose otherwise
+    player = lanes_xorshift(player);
+    Lanes right = lanes_gt(right_max, lanes_shr(player, 24));
+    Lanes random_pose = lanes_and(lanes_shr(player, 16), lanes_set(3));
+    Lanes jumping = lanes_select(right, lanes_set(~0U), lanes_eq(random_pose, one));
+    Lanes crouching = lanes_select(right, lanes_set(~0U), lanes_eq(random_pose, lanes_set(2)));
+
+    // update_step, then check_if_game_over : the pose has to guard the line of the obstacle at column 0
+    Lanes laps = lanes_sub(lanes_load(g->laps + base), lanes_set(~0U));
+    Lanes hit = lanes_or(lanes_andnot(crouching, top), lanes_andnot(jumping, bottom));
+    Lanes over = lanes_or(lanes_eq(lanes_and(hit, one), one), lanes_eq(laps, steps));
+
+    lanes_store(g->top + base, top);
+    lanes_store(g->bottom + base, bottom);
+    lanes_store(g->count + base, count);
+    lanes_store(g->spawn + base, spawn);
+    lanes_store(g->player + base, player);
+    lanes_store(g->laps + base, laps);
+    return over;
+}
+
+/**
+ * Plays the games of consecutive seeds in the lanes of 'registers' registers, and stores the laps of every game.
+ */
+static void play_lockstep(uint32_t first_seed, int32_t games, uint8_t threshold, uint32_t steps, int registers,
+                          uint32_t *laps) {
+    Games g;
+    int lanes = registers * LANES;
+    int32_t next = 0;
+    for (int lane = 0 ; lane < lanes ; lane++) {
+        if (next < games) {
+            start_game(&g, lane, next, first_seed + (uint32_t) next);
+            next++;
+        } else {
+            start_game(&g, lane, -1, 1);
+        }
+    }
+
+    // spawn_next generates an obstacle from a byte >= threshold, the player is right with a byte < skill
+    const Lanes threshold_lanes = lanes_set((uint32_t) threshold - 1);
+    const Lanes skill_lanes = lanes_set(skill);
+    const Lanes steps_lanes = lanes_set(steps);
+
+    int32_t playing = next < lanes ? next : lanes;
+    while (playing > 0) {
+        for (int base = 0 ; base < lanes ; base += LANES) {
+            Lanes over = step_lanes(&g, base, threshold_lanes, skill_lanes, steps_lanes);
+            if (!lanes_any(over))
+                continue;
+
+            uint32_t flags[LANES];
+            lanes_store(flags, over);
+            for (int lane = base ; lane < base + LANES ; lane++) {
+                if (!flags[lane - base] || g.game[lane] < 0)
+                    continue;
+                laps[g.game[lane]] = g.laps[lane];
+                if (next < games) {
+                    start_game(&g, lane, next, first_seed + (uint32_t) next);
+                    next++;
+                } else {
+                    start_game(&g, lane, -1, 1);
+                    playing--;
+                }
+            }
+        }
+    }
+}
+
+/* --- Measurement --- */
+
+static double now_s() {
+    timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+static void report(const char *path, const uint32_t *laps, int32_t games, uint32_t steps, int level, double elapsed) {
+    uint64_t total = 0;
+    int32_t survived = 0;
+    for (int32_t i = 0 ; i < games ; i++) {
+        total += laps[i];
+        survived += laps[i] == steps;
+    }
+    printf("%-9s level=%d skill=%u games=%d mean_laps=%.1f mean_score=%.1f survived=%d games_per_s=%.0f "
+           "steps_per_s=%.3g\n", path, level, (unsigned) skill, (int) games, (double) total / games,
+           (double) total * level / games, (int) survived, games / elapsed, total / elapsed);
+}
+
+int main(int argc, char **argv) {
+    int level = 4, registers = MAX_REGISTERS;
+    uint32_t first = 1, steps = 10000;
+    long games = 100000;
+    const char *corpus = NULL;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "d:s:n:t:k:w:o:")) != -1) {
+        switch (opt) {
+            case 'd': level = atoi(optarg); break;
+            case 's': first = strtoul(optarg, NULL, 0); break;
+            case 'n': games = atol(optarg); break;
+            case 't': steps = strtoul(optarg, NULL, 0); break;
+            case 'k': skill = strtoul(optarg, NULL, 0); break;
+            case 'w': registers = atoi(optarg); break;
+            case 'o': corpus = optarg; break;
+            default:
+                fprintf(stderr, "usage: %s [-d level] [-s seed] [-n games] [-t steps] [-k skill] [-w registers] "
+                        "[-o corpus]\n", argv[0]);
+                return 2;
+        }
+    }
+    if (games < 1 || games > INT32_MAX || steps < 1 || skill > 256 || registers < 1 || registers > MAX_REGISTERS) {
+        fprintf(stderr, "%s: the games and the steps must be at least 1, the skill 0 to 256 and the registers 1 to %d\n",
+                argv[0], MAX_REGISTERS);
+        return 2;
+    }
+
+    const Difficulty *difficulty = NULL;
+    for (int i = 0 ; i < DIFFICULTY_COUNT ; i++)
+        if (DIFFICULTIES[i].level == level)
+            difficulty = &DIFFICULTIES[i];
+    if (difficulty == NULL) {
+        fprintf(stderr, "%s: unknown difficulty level %d\n", argv[0], level);
+        return 2;
+    }
+    uint8_t threshold = difficulty->spawn_threshold;
+
+    uint32_t *scalar = (uint32_t *) malloc(games * sizeof(uint32_t));
+    uint32_t *lockstep = (uint32_t *) malloc(games * sizeof(uint32_t));
+
+    double start = now_s();
+    for (long i = 0 ; i < games ; i++)
+        scalar[i] = play_scalar(first + (uint32_t) i, threshold, steps);
+    double scalar_s = now_s() - start;
+
+    start = now_s();
+    play_lockstep(first, (int32_t) games, threshold, steps, registers, lockstep);
+    double lockstep_s = now_s() - start;
+
+    char path[32];
+    report("scalar", scalar, (int32_t) games, steps, level, scalar_s);
+    snprintf(path, sizeof(path), "%s-x%d", ISA, registers * LANES);
+    report(path, lockstep, (int32_t) games, steps, level, lockstep_s);
+    printf("speedup=%.1f\n", scalar_s / lockstep_s);
+
+    long mismatches = 0;
+    for (long i = 0 ; i < games ; i++) {
+        if (scalar[i] != lockstep[i] && mismatches++ < 10)
+            printf("mismatch seed %lu : scalar %u laps, lockstep %u laps\n", (unsigned long) (first + i),
+                   (unsigned) scalar[i], (unsigned) lockstep[i]);
+    }
+
+    if (corpus != NULL) {
+        static CorpusWriter writer;
+        if (!corpus_create(&writer, corpus)) {
+            fprintf(stderr, "%s: %s is not a corpus file\n", argv[0], corpus);
+            return 2;
+        }
+        uint8_t *poses = (uint8_t *) malloc(steps);
+        bool written = true;
+        start = now_s();
+        for (long i = 0 ; i < games && written ; i++) {
+            uint32_t laps = play_scalar(first + (uint32_t) i, threshold, steps, poses);
+            written = corpus_add(&writer, first + (uint32_t) i, (uint8_t) level, laps, poses);
+        }
+        written = corpus_finish(&writer) && written;
+        printf("corpus    games=%ld games_per_s=%.0f\n", games, games / (now_s() - start));
+        free(poses);
+        if (!written) {
+            perror(corpus);
+            return 2;
+        }
+    }
+
+    free(scalar);
+    free(lockstep);
+    return mismatches != 0;
+}
@@ -0,0 +1,242 @@
+/**
+ * ---- spawn solver ----
+ * Tells whether the obstacles of a life can be survived at all : for every seed, replays the random stream of
+ * spawn/spawn.hpp with the spawn threshold of a difficulty, and computes how long a perfect player survives.
+ *
+ * The perfect player is held to the limits of a human one : once the dino starts running, jumping or crouching, it
+ * keeps doing so for at least 'hold' game steps. An obstacle on the top line at column 0 needs the dino to crouch, one
+ * on the bottom line needs it to jump, exactly as check_if_game_over() in main.cpp.
+ *
+ * The obstacles move whatever the player does, so the playfield is simulated once per seed, as two bitmasks of
+ * columns (one per line), and the player is a dynamic program over the game steps : the set of the (pose, steps held)
+ * states that can be reached without dying, kept as a bitmask and advanced with a few shifts per step. The seed is
+ * survivable for as long as this set is not empty. Millions of seeds are evaluated per minute.
+ *
+ * Usage: spawn_solver [-d level] [-s seed] [-n seeds] [-t steps] [-H hold] [-u max] [-p]
+ *   -d level  - difficulty level, 1 to 4 (default 4)
+ *   -s seed   - first seed to evaluate (default 1)
+ *   -n seeds  - number of consecutive seeds to evaluate (default 1000000)
+ *   -t steps  - number of game steps a life has to last to be survivable (default 1000)
+ *   -H hold   - game steps a pose is held at least, 1 to 10 (default 3)
+ *   -u max    - number of unsurvivable seeds to list (default 20)
+ *   -p        - print the playfield and the poses of a perfect player for the first seed
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../difficulty/difficulty.hpp"
+#include "../spawn/spawn.hpp"
+
+#define MAX_HOLD 10
+
+// Poses of the dino
+enum Pose { RUN, JUMP, CROUCH, POSE_COUNT };
+static const char POSE_CHARS[POSE_COUNT] = { '>', '^', 'v' };
+
+static int hold = 3;
+static uint32_t full;    // bits of the states of one pose : bit k - 1 is 'held for k steps' (k = hold meaning k or more)
+static uint32_t held;    // bit of the states of one pose which may change pose
+
+/**
+ * Struct: Playfield
+ * Obstacles on screen, as one bitmask of columns per line : bit x is set if there is an obstacle at column x.
+ */
+struct Playfield {
+    uint32_t top, bottom;
+    SpawnRng rng;
+    uint8_t threshold;
+};
+
+static void playfield_init(Playfield *f, uint32_t seed, uint8_t threshold) {
+    f->top = f->bottom = 0;
+    spawn_seed(&f->rng, seed);
+    f->threshold = threshold;
+}
+
+/**
+ * Moves the obstacles one column closer, then generates a new one the same way as generate_obstacle() in main.cpp.
+ * Returns the pose needed to survive this step : JUMP or CROUCH if an obstacle is at column 0, RUN if any pose will do.
+ */
+static Pose playfield_step(Playfield *f) {
+    f->top >>= 1;
+    f->bottom >>= 1;
+
+    uint32_t all = f->top | f->bottom;
+    int count = __builtin_popcount(all);
+    int last_x = all ? 31 - __builtin_clz(all) : 0;
+    int8_t line = spawn_next(&f->rng, f->threshold, spawn_allowed(count, last_x));
+    if (line == 0)
+        f->top |= 1UL << SPAWN_X;
+    else if (line == 1)
+        f->bottom |= 1UL << SPAWN_X;
+
+    return (f->top & 1) ? CROUCH : (f->bottom & 1) ? JUMP : RUN;
+}
+
+/**
+ * Advances the set of reachable states by one step, before the obstacles are taken into account : every pose is kept
+ * one more step, and the poses held long enough may change.
+ */
+static uint32_t advance(uint32_t states) {
+    uint32_t next = 0, changing = 0;
+    for (int p = 0 ; p < POSE_COUNT ; p++) {
+        uint32_t g = (states >> (p * hold)) & full;
+        next |= (((g << 1) | (g & held)) & full) << (p * hold);
+        if (g & held)
+            changing |= 1UL << p;
+    }
+    for (int p = 0 ; p < POSE_COUNT ; p++)
+        if (changing & ~(1UL << p))
+            next |= 1UL << (p * hold);
+    return next;
+}
+
+/**
+ * Keeps the states of the reachable set which survive a step needing the given pose.
+ */
+static uint32_t survive(uint32_t states, Pose needed) {
+    return needed == RUN ? states : states & (full << (needed * hold));
+}
+
+/**
+ * Returns the number of game steps a perfect player survives with the given seed, up to 'steps'. If 'trace' is not
+ * NULL, it receives the reachable set of every step.
+ */
+static int solve(uint32_t seed, uint8_t threshold, int steps, uint32_t *trace) {
+    Playfield f;
+    playfield_init(&f, seed, threshold);
+
+    uint32_t states = held << (RUN * hold); // running for long enough to do anything at the start
+    for (int step = 0 ; step < steps ; step++) {
+        states = survive(advance(states), playfield_step(&f));
+        if (trace)
+            trace[step] = states;
+        if (states == 0)
+            return step;
+    }
+    return steps;
+}
+
+/**
+ * Prints the playfield of every step of a seed, with the pose of a perfect player found by walking the reachable sets
+ * backwards.
+ */
+static void print_plan(uint32_t seed, uint8_t threshold, int steps) {
+    uint32_t *trace = (uint32_t *) malloc(steps * sizeof(uint32_t));
+    int survived = solve(seed, threshold, steps, trace);
+    int last = survived < steps ? survived : steps - 1; // the step of the death, or the last one
+
+    // Walk backwards from any state of the last step, to a predecessor of it in the previous step, ...
+    char *poses = (char *) malloc(steps);
+    int state = survived < steps ? -1 : __builtin_ctz(trace[last]);
+    for (int step = last ; step >= 0 ; step--) {
+        if (state < 0) {
+            poses[step] = 'X';
+            if (step > 0 && trace[step - 1])
+                state = __builtin_ctz(trace[step - 1]); // any state survived the step before the death
+            continue;
+        }
+        poses[step] = POSE_CHARS[state / hold];
+        if (step == 0)
+            break;
+        for (int prev = 0 ; prev < POSE_COUNT * hold ; prev++) {
+            if ((trace[step - 1] >> prev & 1) && (advance(1UL << prev) >> state & 1)) {
+                state = prev;
+                break;
+            }
+        }
+    }
+
+    Playfield f;
+    playfield_init(&f, seed, threshold);
+    printf("step  top               bottom            pose\n");
+    for (int step = 0 ; step <= last ; step++) {
+        playfield_step(&f);
+        char top[SPAWN_X + 2], bottom[SPAWN_X + 2];
+        for (int x = 0 ; x <= SPAWN_X ; x++) {
+            top[x] = (f.top >> x & 1) ? 'x' : '.';
+            bottom[x] = (f.bottom >> x & 1) ? 'X' : '.';
+        }
+        top[SPAWN_X + 1] = bottom[SPAWN_X + 1] = '\0';
+        printf("%4d  %s %s %c\n", step, top, bottom, poses[step]);
+    }
+    printf("seed %lu : %s after %d steps\n", (unsigned long) seed, survived < steps ? "dies" : "survives", survived);
+
+    free(poses);
+    free(trace);
+}
+
+int main(int argc, char **argv) {
+    int level = 4, steps = 1000, max_unfair = 20;
+    uint32_t first = 1;
+    long seeds = 1000000;
+    bool plan = false;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "d:s:n:t:H:u:p")) != -1) {
+        switch (opt) {
+            case 'd': level = atoi(optarg); break;
+            case 's': first = strtoul(optarg, NULL, 0); break;
+            case 'n': seeds = atol(optarg); break;
+            case 't': steps = atoi(optarg); break;
+            case 'H': hold = atoi(optarg); break;
+            case 'u': max_unfair = atoi(optarg); break;
+            case 'p': plan = true; break;
+            default:
+                fprintf(stderr, "usage: %s [-d level] [-s seed] [-n seeds] [-t steps] [-H hold] [-u max] [-p]\n", argv[0]);
+                return 2;
+        }
+    }
+    if (hold < 1 || hold > MAX_HOLD || steps < 1 || seeds < 1) {
+        fprintf(stderr, "%s: the hold must be 1 to %d, the steps and the seeds at least 1\n", argv[0], MAX_HOLD);
+        return 2;
+    }
+
+    const Difficulty *difficulty = NULL;
+    for (int i = 0 ; i < DIFFICULTY_COUNT ; i++)
+        if (DIFFICULTIES[i].level == level)
+            difficulty = &DIFFICULTIES[i];
+    if (difficulty == NULL) {
+        fprintf(stderr, "%s: unknown difficulty level %d\n", argv[0], level);
+        return 2;
+    }
+
+    full = (1UL << hold) - 1;
+    held = 1UL << (hold - 1);
+
+    if (plan) {
+        print_plan(first, difficulty->spawn_threshold, steps);
+        return 0;
+    }
+
+    timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    long survivable = 0, unfair = 0;
+    uint64_t total = 0;
+    int shortest = steps;
+    for (long i = 0 ; i < seeds ; i++) {
+        uint32_t seed = first + (uint32_t) i;
+        int survived = solve(seed, difficulty->spawn_threshold, steps, NULL);
+        total += survived;
+        if (survived < shortest)
+            shortest = survived;
+        if (survived == steps) {
+            survivable++;
+        } else if (unfair++ < max_unfair) {
+            printf("unsurvivable seed %lu : dies after %d steps\n", (unsigned long) seed, survived);
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+    printf("level=%d hold=%d steps=%d seeds=%ld survivable=%ld (%.3f%%) shortest=%d mean_steps=%.1f "
+           "seeds_per_s=%.0f\n", level, hold, steps, seeds, survivable, 100.0 * survivable / seeds, shortest,
+           (double) total / seeds, seeds / elapsed);
+    return 0;
+}
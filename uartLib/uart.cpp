@@ -1,15 +1,26 @@
 #include "uart.hpp"
+#include "../probe/probe.hpp"
+#include "../spsc/spsc.hpp"
+#include <avr/interrupt.h>
+
+// Bytes received by the RX interrupt, waiting for USART_Read_Line
+static Spsc<char, USART_RX_QUEUE_SIZE> rxQueue;
+
+// Line being read by USART_Read_Line
+static char rxLine[USART_LINE_SIZE];
+static unsigned char rxLength = 0;
 
 void init_uart(unsigned short ubrr  ) {
     // setting the baud rate  based on the datasheet
     UBRR0H =(unsigned char)  ( ubrr>> 8);  // 0x00
     UBRR0L =(unsigned char) ubrr;  // 0x0C
-    // enabling TX & RX
-    UCSR0B = (1<<RXEN0)|(1<<TXEN0);
+    // enabling TX & RX, and the RX interrupt filling the line buffer
+    UCSR0B = (1<<RXEN0)|(1<<TXEN0)|(1<<RXCIE0);
     //UCSR0A = (1<<UDRE0)|(1<<U2X0);
     UCSR0C =  (1 << UCSZ01) | (1 << UCSZ00);    // Set frame: 8data, 1 stop
 }
 
+// Blocking receive, without the RX interrupt : only usable if RXCIE0 is cleared
 unsigned char USART_Receive( void ) {
     /* Wait for data to be received */
     while ( !(UCSR0A & (1<<RXC0)) );
@@ -26,10 +37,40 @@ void USART_Transmit_Byte( unsigned char data ) {
 }
 
 void USART_Transmit_String( char* str) {
+	PROBE_BEGIN(PROBE_UART);
 	for (int j = 0; j < strlen(str) + 1; j++){
 		USART_Transmit_Byte((unsigned char)str[j]);
 		//USART_Transmit_Byte((unsigned char)j);
 	}
 	USART_Transmit_Byte('\r');
 	USART_Transmit_Byte('\n');
+	PROBE_END(PROBE_UART);
+}
+
+ISR(USART_RX_vect) {
+    char c = UDR0;
+    // The main program is too far behind : the byte is dropped
+    rxQueue.push(c);
+}
+
+bool USART_Read_Line( char* line, unsigned char size) {
+    /* Non-blocking : returns false if no complete line was received */
+    char c;
+    while (rxQueue.pop(&c)) {
+        if (c == '\r' || c == '\n') {
+            // End of line, ignoring the empty ones (such as the '\n' of "\r\n")
+            if (rxLength == 0)
+                continue;
+            unsigned char n = rxLength < size - 1 ? rxLength : size - 1;
+            for (unsigned char i = 0; i < n; i++)
+                line[i] = rxLine[i];
+            line[n] = '\0';
+            rxLength = 0;
+            return true;
+        }
+        // Too long lines are truncated
+        if (rxLength < USART_LINE_SIZE - 1)
+            rxLine[rxLength++] = c;
+    }
+    return false;
 }
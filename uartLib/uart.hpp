@@ -2,7 +2,14 @@
 #include <util/delay.h>
 #include <string.h>
 
+// Longest line received by USART_Read_Line, with its terminating null character
+#define USART_LINE_SIZE 32
+
+// Bytes received and not read by USART_Read_Line yet, at most (a power of 2, at most 128)
+#define USART_RX_QUEUE_SIZE 32
+
 void init_uart(unsigned short ubrr);
 unsigned char USART_Receive( void );
 void USART_Transmit_Byte( unsigned char data);
 void USART_Transmit_String( char* str);
+bool USART_Read_Line( char* line, unsigned char size);
@@ -7,7 +7,42 @@
 static const int defaultVectorAlloc = 4; // default allocation value
 static const int kNotFound = -1; // not found sentinel
 
+#ifdef __BIGGEST_ALIGNMENT__
+static const size_t kArenaAlign = __BIGGEST_ALIGNMENT__; // alignment of the blocks of an arena
+#else
+static const size_t kArenaAlign = sizeof(void *);
+#endif
+
+static void *HeapResize(void *context, void *block, size_t oldSize, size_t newSize)
+{
+    if (newSize == 0) {
+        free(block);
+        return NULL;
+    }
+    return realloc(block, newSize);
+}
+
+const VectorAllocator VectorHeapAllocator = { HeapResize, NULL };
+
+/**
+ * Function: InlineElems
+ * ---------------------
+ * Storage of the first elements of a vector created with VECTOR_INLINE, which
+ * is the v member of an InlineVector.
+ */
+
+static unsigned char *InlineElems(const vector *v)
+{
+    return ((InlineVector*)v)->inlineElems;
+}
+
 void VectorNew(vector *v, int elemSize, VectorFreeFunction freeFn, int initialAllocation)
+{
+    VectorNewWith(v, elemSize, freeFn, initialAllocation, NULL, 0);
+}
+
+void VectorNewWith(vector *v, int elemSize, VectorFreeFunction freeFn, int initialAllocation,
+                   const VectorAllocator *allocator, int flags)
 {
     if (initialAllocation == 0) {
         initialAllocation = defaultVectorAlloc;
@@ -17,13 +52,53 @@ void VectorNew(vector *v, int elemSize, VectorFreeFunction freeFn, int initialAl
     assert(initialAllocation > 0);
 
     v->elemSize = elemSize;
-    v->allocLength = initialAllocation;
+    v->growBy = initialAllocation;
     v->logLength = 0;
+    v->freefn = freeFn;
+    v->flags = flags;
+    v->allocator = allocator != NULL ? *allocator : VectorHeapAllocator;
+
+    int inlineLength = (flags & VECTOR_INLINE) ? VECTOR_INLINE_BYTES / elemSize : 0;
+    if (inlineLength > 0) {
+        v->elems = InlineElems(v);
+        v->allocLength = inlineLength;
+        if (initialAllocation > inlineLength) {
+            VectorReserve(v, initialAllocation);
+        }
+    } else {
+        v->elems = v->allocator.resize(v->allocator.context, NULL, 0, (size_t)initialAllocation * elemSize);
+        assert(v->elems != NULL);
+        v->allocLength = initialAllocation;
+    }
+}
 
-    v->elems = malloc(initialAllocation * elemSize);
-    assert(v->elems != NULL);
+static bool IsInline(const vector *v)
+{
+    return (v->flags & VECTOR_INLINE) && v->elems == InlineElems(v);
+}
 
-    v->freefn = freeFn;
+/**
+ * Function: Reallocate
+ * --------------------
+ * Sets the allocated length of the vector, moving its elements out of (or back
+ * into) the inline storage when needed.
+ */
+
+static void Reallocate(vector *v, int allocLength)
+{
+    size_t newSize = (size_t)allocLength * v->elemSize;
+
+    if (IsInline(v)) {
+        void *elems = v->allocator.resize(v->allocator.context, NULL, 0, newSize);
+        assert(elems != NULL);
+        memcpy(elems, InlineElems(v), v->logLength * v->elemSize);
+        v->elems = elems;
+    } else {
+        v->elems = v->allocator.resize(v->allocator.context, v->elems,
+                                       (size_t)v->allocLength * v->elemSize, newSize);
+        assert(v->elems != NULL);
+    }
+    v->allocLength = allocLength;
 }
 
 void VectorDispose(vector *v)
@@ -34,14 +109,169 @@ void VectorDispose(vector *v)
         }
     }
 
-    free(v->elems);
+    if (!IsInline(v) && v->elems != NULL) {
+        v->allocator.resize(v->allocator.context, v->elems, (size_t)v->allocLength * v->elemSize, 0);
+    }
+    v->elems = NULL;
+    v->logLength = 0;
+    v->allocLength = 0;
 }
 
-static void DoubleCapacity(vector *v)
+/**
+ * Function: Grow
+ * --------------
+ * Grows the vector by chunks of initialAllocation elements, as documented in
+ * VectorNew, until it can hold one more element.
+ */
+
+static void Grow(vector *v)
 {
-    v->allocLength *= 2;
-    v->elems = realloc(v->elems, v->allocLength * v->elemSize);
-    assert(v->elems != NULL);
+    int allocLength = v->allocLength + v->growBy;
+    while (allocLength <= v->logLength) {
+        allocLength += v->growBy;
+    }
+    Reallocate(v, allocLength);
+}
+
+void VectorReserve(vector *v, int capacity)
+{
+    if (capacity > v->allocLength) {
+        Reallocate(v, capacity);
+    }
+}
+
+void VectorShrink(vector *v)
+{
+    if (IsInline(v)) {
+        return;
+    }
+
+    int inlineLength = (v->flags & VECTOR_INLINE) ? VECTOR_INLINE_BYTES / v->elemSize : 0;
+    if (inlineLength > 0 && v->logLength <= inlineLength) {
+        // move back into the inline storage
+        memcpy(InlineElems(v), v->elems, v->logLength * v->elemSize);
+        v->allocator.resize(v->allocator.context, v->elems, (size_t)v->allocLength * v->elemSize, 0);
+        v->elems = InlineElems(v);
+        v->allocLength = inlineLength;
+    } else {
+        // an empty vector keeps room for one element, so that its elements are never NULL while it lives
+        int allocLength = v->logLength > 0 ? v->logLength : 1;
+        if (v->allocLength > allocLength) {
+            Reallocate(v, allocLength);
+        }
+    }
+}
+
+int VectorCapacity(const vector *v)
+{
+    return v->allocLength;
+}
+
+static size_t ArenaRound(size_t size)
+{
+    return (size + kArenaAlign - 1) & ~(kArenaAlign - 1);
+}
+
+void VectorArenaInit(VectorArena *arena, void *buffer, size_t size)
+{
+    char *base = (char*)buffer;
+    size_t skip = ArenaRound((size_t)base) - (size_t)base; // align the first block
+
+    arena->base = base + skip;
+    arena->size = size > skip ? size - skip : 0;
+    arena->used = 0;
+    arena->highWater = 0;
+}
+
+void VectorArenaReset(VectorArena *arena)
+{
+    arena->used = 0;
+}
+
+static void *ArenaResize(void *context, void *block, size_t oldSize, size_t newSize)
+{
+    VectorArena *arena = (VectorArena*)context;
+    char *top = arena->base + arena->used;
+    size_t offset;
+
+    if (block != NULL && (char*)block + ArenaRound(oldSize) == top) {
+        // last block : grows, shrinks or is given back in place
+        offset = (char*)block - arena->base;
+    } else {
+        if (newSize == 0) {
+            return NULL; // reclaimed by VectorArenaReset
+        }
+        if (block != NULL && newSize <= oldSize) {
+            return block;
+        }
+        offset = arena->used;
+    }
+
+    if (offset + ArenaRound(newSize) > arena->size) {
+        return NULL;
+    }
+
+    char *newBlock = arena->base + offset;
+    if (block != NULL && newBlock != block) {
+        memcpy(newBlock, block, oldSize);
+    }
+    arena->used = offset + ArenaRound(newSize);
+    if (arena->used > arena->highWater) {
+        arena->highWater = arena->used;
+    }
+    return newSize == 0 ? NULL : newBlock;
+}
+
+VectorAllocator VectorArenaAllocator(VectorArena *arena)
+{
+    VectorAllocator allocator = { ArenaResize, arena };
+    return allocator;
+}
+
+void VectorPoolInit(VectorPool *pool, void *buffer, size_t blockSize, int blockCount)
+{
+    assert(blockSize >= sizeof(void *));
+
+    pool->base = (char*)buffer;
+    pool->blockSize = blockSize;
+    pool->blockCount = blockCount;
+    pool->freeList = NULL;
+    for (int i = blockCount - 1; i >= 0; i--) {
+        void *block = pool->base + i * blockSize;
+        memcpy(block, &pool->freeList, sizeof(void *)); // link to the next free block
+        pool->freeList = block;
+    }
+}
+
+static void *PoolResize(void *context, void *block, size_t oldSize, size_t newSize)
+{
+    VectorPool *pool = (VectorPool*)context;
+
+    if (newSize == 0) {
+        if (block != NULL) {
+            memcpy(block, &pool->freeList, sizeof(void *));
+            pool->freeList = block;
+        }
+        return NULL;
+    }
+    if (newSize > pool->blockSize) {
+        return NULL;
+    }
+    if (block != NULL) {
+        return block;
+    }
+
+    block = pool->freeList;
+    if (block != NULL) {
+        memcpy(&pool->freeList, block, sizeof(void *));
+    }
+    return block;
+}
+
+VectorAllocator VectorPoolAllocator(VectorPool *pool)
+{
+    VectorAllocator allocator = { PoolResize, pool };
+    return allocator;
 }
 
 int VectorLength(const vector *v)
@@ -81,7 +311,7 @@ void VectorInsert(vector *v, const void *elemAddr, int position)
     }
 
     if (v->logLength == v->allocLength) {
-        DoubleCapacity(v);
+        Grow(v);
     }
 
     void *startShiftAddr = (char*)v->elems + (position * v->elemSize);
@@ -98,7 +328,7 @@ void VectorInsert(vector *v, const void *elemAddr, int position)
 void VectorAppend(vector *v, const void *elemAddr)
 {
     if (v->logLength == v->allocLength) {
-        DoubleCapacity(v);
+        Grow(v);
     }
 
     void *destAddr = (char*)v->elems + v->logLength * v->elemSize;
@@ -131,6 +361,47 @@ void VectorDelete(vector *v, int position)
     v->logLength--;
 }
 
+int VectorRemoveIf(vector *v, VectorPredicateFunction predicate, void *auxData)
+{
+    assert(predicate != NULL);
+
+    char *readAddr = (char*)v->elems;
+    char *writeAddr = readAddr; // next slot of the remaining elements
+    char *endAddr = readAddr + (v->logLength * v->elemSize);
+
+    for (; readAddr < endAddr; readAddr += v->elemSize) {
+        if (predicate(readAddr, auxData)) {
+            if (v->freefn != NULL) {
+                v->freefn(readAddr);
+            }
+        } else {
+            if (writeAddr != readAddr) {
+                memcpy(writeAddr, readAddr, v->elemSize);
+            }
+            writeAddr += v->elemSize;
+        }
+    }
+
+    int removed = (endAddr - writeAddr) / v->elemSize;
+    v->logLength -= removed;
+    return removed;
+}
+
+void VectorSwapRemove(vector *v, int position)
+{
+    assert(position >= 0 && position < v->logLength);
+
+    void *elemAddr = (char*)v->elems + (position * v->elemSize);
+    if (v->freefn != NULL) {
+        v->freefn(elemAddr);
+    }
+
+    v->logLength--;
+    if (position != v->logLength) {
+        memcpy(elemAddr, (char*)v->elems + (v->logLength * v->elemSize), v->elemSize);
+    }
+}
+
 void VectorSort(vector *v, VectorCompareFunction compare)
 {
     assert(compare != NULL);
@@ -146,58 +417,40 @@ void VectorMap(vector *v, VectorMapFunction mapFn, void *auxData)
     }
 }
 
-/**
-* Calculates index from the difference between found address and start address.
-**/
-/*
-static int GetIndex(const vector *v, void *found, int startIndex)
-{
-    void *startAddr = (char*)v->elems + (startIndex * v->elemSize);
-
-    int start = (int)startAddr;
-    int foundAddr = (int)found;
-    int diff = (foundAddr - start) / v->elemSize;
-    return diff;
-}
-
-static void *BinarySearchVector(const vector *v, const void *key,
-                                VectorCompareFunction searchFn, int startIndex,
-                                bool isSorted, size_t size)
-{
-    return bsearch(key,(char*)v->elems + (startIndex * v->elemSize),
-                   size,v->elemSize,searchFn);
-}
-*/
-
-/*
-static void *LinearSearchVector(const vector *v, const void *key,
-                                VectorCompareFunction searchFn, int startIndex,
-                                bool isSorted, size_t size)
-{
-    return lfind(key,(char*)v->elems + (startIndex * v->elemSize),
-                 &size,v->elemSize,searchFn);
-}
-*/
-
-/*
 int VectorSearch(const vector *v, const void *key, VectorCompareFunction searchFn,
                  int startIndex, bool isSorted)
 {
-    assert(searchFn != NULL || key != NULL);
-
-    void *found; // address of found element
-    size_t size = v->logLength - startIndex; // size of block to test
+    assert(searchFn != NULL && key != NULL);
+    assert(startIndex >= 0 && startIndex <= v->logLength);
 
     if (isSorted) {
-        found = BinarySearchVector(v,key,searchFn,startIndex,isSorted,size);
-    } else {
-        found = LinearSearchVector(v,key,searchFn,startIndex,isSorted,size);
+        // binary search of the first element which is not less than the key
+        int n = v->logLength - startIndex;
+        if (n == 0) {
+            return kNotFound;
+        }
+        char *base = (char*)v->elems + (startIndex * v->elemSize);
+        while (n > 1) {
+            int half = n / 2;
+            if (searchFn(key, base + (half * v->elemSize)) > 0) {
+                base += half * v->elemSize;
+            }
+            n -= half;
+        }
+        if (searchFn(key, base) > 0) {
+            base += v->elemSize;
+        }
+        int position = (base - (char*)v->elems) / v->elemSize;
+        if (position < v->logLength && searchFn(key, base) == 0) {
+            return position;
+        }
+        return kNotFound;
     }
 
-    if (found == NULL) {
-        return kNotFound;
-    } else {
-        return GetIndex(v, found, startIndex);
+    for (int i = startIndex; i < v->logLength; i++) {
+        if (searchFn(key, (char*)v->elems + (i * v->elemSize)) == 0) {
+            return i;
+        }
     }
+    return kNotFound;
 }
- */
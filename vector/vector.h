@@ -17,6 +17,18 @@
 #define _vector_
 
 //#include "bool.h"
+#include <stddef.h>
+
+/**
+ * Constant: VECTOR_INLINE_BYTES
+ * -----------------------------
+ * Size of the storage embedded in an InlineVector, which holds its first
+ * elements without allocating any memory.  Can be overridden at compile time.
+ */
+
+#ifndef VECTOR_INLINE_BYTES
+#define VECTOR_INLINE_BYTES 32
+#endif
 
 /**
  * Type: VectorCompareFunction
@@ -56,6 +68,76 @@ typedef void (*VectorMapFunction)(void *elemAddr, void *auxData);
 
 typedef void (*VectorFreeFunction)(void *elemAddr);
 
+/**
+ * Type: VectorPredicateFunction
+ * -----------------------------
+ * VectorPredicateFunction defines the space of functions that can be used to
+ * select elements of a vector, as with VectorRemoveIf.  The predicate is given
+ * the address of an element and the client's auxiliary data, and returns true
+ * when the element is selected.  It is allowed to modify the element.
+ */
+
+typedef bool (*VectorPredicateFunction)(void *elemAddr, void *auxData);
+
+/**
+ * Type: VectorResizeFunction
+ * --------------------------
+ * VectorResizeFunction is a pointer to a function which manages the memory
+ * of a vector.  It is called with a NULL block and an oldSize of 0 to allocate
+ * a new block of newSize bytes, with an existing block and its size to grow or
+ * shrink it to newSize bytes (possibly moving it, in which case its contents are
+ * copied), and with a newSize of 0 to release the block.  It returns the block,
+ * or NULL if the request cannot be satisfied.  The context pointer of the
+ * allocator is passed back to every call.
+ */
+
+typedef void *(*VectorResizeFunction)(void *context, void *block, size_t oldSize, size_t newSize);
+
+/**
+ * Type: VectorAllocator
+ * ---------------------
+ * Defines where a vector takes its memory from : a resize function and
+ * the context it works on.  Three allocators are provided : the heap
+ * (VectorHeapAllocator), a bump arena (VectorArenaAllocator) and a pool of
+ * fixed-size blocks (VectorPoolAllocator).
+ */
+
+typedef struct {
+    VectorResizeFunction resize;
+    void *context;
+} VectorAllocator;
+
+/**
+ * Type: VectorArena
+ * -----------------
+ * A bump allocator over a client-supplied buffer, typically static.  Blocks
+ * are carved one after the other; only the last block can grow in place or be
+ * given back, the others are reclaimed all at once by VectorArenaReset.
+ */
+
+typedef struct {
+    char *base;
+    size_t size;
+    size_t used;
+    size_t highWater;
+} VectorArena;
+
+/**
+ * Type: VectorPool
+ * ----------------
+ * A pool of blocks of the same size over a client-supplied buffer, typically
+ * static.  Every allocation takes a whole block, so a vector allocated from a
+ * pool can never grow beyond blockSize bytes, but the blocks can be given back
+ * and reused in any order.
+ */
+
+typedef struct {
+    char *base;
+    size_t blockSize;
+    int blockCount;
+    void *freeList;
+} VectorPool;
+
 /**
  * Type: vector
  * ------------
@@ -72,9 +154,37 @@ typedef struct {
     int elemSize;
     int logLength;
     int allocLength;
+    int growBy;
+    int flags;
     VectorFreeFunction freefn;
+    VectorAllocator allocator;
 } vector;
 
+/**
+ * Type: InlineVector
+ * ------------------
+ * A vector followed by VECTOR_INLINE_BYTES of storage for its first elements.
+ * Only the vectors which are declared as such pay for that storage, and the
+ * vector is used through the v member like any other, once created with the
+ * VECTOR_INLINE flag.
+ */
+
+typedef struct {
+    vector v;
+    unsigned char inlineElems[VECTOR_INLINE_BYTES];
+} InlineVector;
+
+/**
+ * Constant: VECTOR_INLINE
+ * -----------------------
+ * Flag of VectorNewWith, for the v member of an InlineVector only : the vector
+ * keeps its first elements in the inlineElems storage which follows it, and
+ * only asks its allocator for memory once they no longer fit.  Such a vector
+ * points into its InlineVector, so it must not be copied by value.
+ */
+
+#define VECTOR_INLINE 1
+
 void debug(char *s);
 
 /**
@@ -129,6 +239,119 @@ void debug(char *s);
 
 void VectorNew(vector *v, int elemSize, VectorFreeFunction freefn, int initialAllocation);
 
+/**
+ * Function: VectorNewWith
+ * Usage: static char storage[256];
+ *        VectorArena arena;
+ *        VectorArenaInit(&arena, storage, sizeof(storage));
+ *        VectorAllocator allocator = VectorArenaAllocator(&arena);
+ *        InlineVector obstacles;
+ *        VectorNewWith(&obstacles.v, sizeof(Obstacle), NULL, 8, &allocator, VECTOR_INLINE);
+ * -----------------------
+ * Same as VectorNew, with the memory of the vector coming from the given
+ * allocator instead of the heap (NULL selects the heap).  The allocator is
+ * copied into the vector.  If flags contains VECTOR_INLINE, the elements are
+ * held in the vector's inline storage for as long as VECTOR_INLINE_BYTES can
+ * hold them : the allocator is first used when the vector outgrows it (or
+ * right away if initialAllocation elements don't fit in it), after which the
+ * vector grows in chunks of initialAllocation elements as usual.
+ */
+
+void VectorNewWith(vector *v, int elemSize, VectorFreeFunction freefn, int initialAllocation,
+                   const VectorAllocator *allocator, int flags);
+
+/**
+ * Function: VectorReserve
+ * -----------------------
+ * Makes sure the vector has room for at least capacity elements, so that
+ * the next appends and insertions up to that length don't reallocate.  The
+ * allocated length becomes exactly capacity if it has to grow.  An assert is
+ * raised if the memory cannot be allocated.
+ */
+
+void VectorReserve(vector *v, int capacity);
+
+/**
+ * Function: VectorShrink
+ * ----------------------
+ * Reduces the allocated length of the vector to its logical length (one
+ * element at least), giving the unused memory back to the allocator.  A
+ * vector created with VECTOR_INLINE moves back to its inline storage if its
+ * elements fit in it.
+ */
+
+void VectorShrink(vector *v);
+
+/**
+ * Function: VectorCapacity
+ * ------------------------
+ * Returns the allocated length of the vector, i.e. the number of elements it
+ * can hold before it has to grow.
+ */
+
+int VectorCapacity(const vector *v);
+
+/**
+ * Constant: VectorHeapAllocator
+ * -----------------------------
+ * Allocator using malloc, realloc and free.  This is the allocator of the
+ * vectors created with VectorNew.
+ */
+
+extern const VectorAllocator VectorHeapAllocator;
+
+/**
+ * Function: VectorArenaInit
+ * Usage: static char storage[256];
+ *        VectorArena arena;
+ *        VectorArenaInit(&arena, storage, sizeof(storage));
+ * -------------------------
+ * Makes an empty arena of the given buffer.  The buffer must outlive every
+ * vector allocated from the arena.
+ */
+
+void VectorArenaInit(VectorArena *arena, void *buffer, size_t size);
+
+/**
+ * Function: VectorArenaReset
+ * --------------------------
+ * Gives back every block of the arena at once, in constant time.  The vectors
+ * allocated from the arena must not be used anymore, not even disposed of :
+ * they have to be created again.  The high-water mark is kept.
+ */
+
+void VectorArenaReset(VectorArena *arena);
+
+/**
+ * Function: VectorArenaAllocator
+ * ------------------------------
+ * Returns an allocator taking its memory from the arena.
+ */
+
+VectorAllocator VectorArenaAllocator(VectorArena *arena);
+
+/**
+ * Function: VectorPoolInit
+ * Usage: static char storage[4 * 32];
+ *        VectorPool pool;
+ *        VectorPoolInit(&pool, storage, 32, 4);
+ * ------------------------
+ * Makes a pool of blockCount blocks of blockSize bytes out of the given
+ * buffer, which must be at least blockSize * blockCount bytes long and
+ * outlive every vector allocated from the pool.  An assert is raised if
+ * blockSize cannot hold a pointer.
+ */
+
+void VectorPoolInit(VectorPool *pool, void *buffer, size_t blockSize, int blockCount);
+
+/**
+ * Function: VectorPoolAllocator
+ * -----------------------------
+ * Returns an allocator taking its memory from the pool.
+ */
+
+VectorAllocator VectorPoolAllocator(VectorPool *pool);
+
 /**
  * Function: VectorDispose
  *           VectorDispose(&studentsDroppingTheCourse);
@@ -225,6 +448,37 @@ void VectorReplace(vector *v, const void *elemAddr, int position);
 
 void VectorDelete(vector *v, int position);
 
+/**
+ * Function: VectorRemoveIf
+ * ------------------------
+ * Removes every element of the vector for which the predicate returns true,
+ * in a single pass : the remaining elements are moved down over the removed ones,
+ * each at most once, and keep their relative order.  The ArrayFreeFunction that was
+ * supplied to VectorNew is called on every removed element.  The predicate may
+ * modify the elements it is given, so an update and the removal of the elements
+ * it invalidates can be done in the same pass.  The auxData is passed to every
+ * call of the predicate.  Returns the number of removed elements.
+ *
+ * An assert is raised if the predicate is NULL.  This method runs in linear time,
+ * whatever the number of removed elements, and does not shrink the allocated size
+ * of the vector.
+ */
+
+int VectorRemoveIf(vector *v, VectorPredicateFunction predicate, void *auxData);
+
+/**
+ * Function: VectorSwapRemove
+ * --------------------------
+ * Deletes the element at the specified position from the vector by moving the
+ * last element into its place, after calling the ArrayFreeFunction that was supplied
+ * to VectorNew on it.  Unlike VectorDelete, the order of the elements is not preserved.
+ *
+ * An assert is raised if position is less than 0 or greater than the logical length
+ * minus one.  This method runs in constant time.
+ */
+
+void VectorSwapRemove(vector *v, int position);
+
 /*
  * Function: VectorSearch
  * ----------------------
@@ -245,6 +499,10 @@ void VectorDelete(vector *v, int position);
  * find anything, allowing this case means you can search an entirely empty
  * vector from 0 without getting an assert).  An assert is raised if the
  * comparator or the key is NULL.
+ *
+ * The comparator is called with the key as its first argument and an element
+ * as its second one, as with bsearch and lfind.  When the vector is sorted and
+ * several elements match, the position of the first of them is returned.
  */
 
 int VectorSearch(const vector *v, const void *key, VectorCompareFunction searchfn, int startIndex, bool isSorted);
@@ -272,4 +530,129 @@ void VectorSort(vector *v, VectorCompareFunction comparefn);
 
 void VectorMap(vector *v, VectorMapFunction mapfn, void *auxData);
 
-#endif
\ No newline at end of file
+#ifdef __cplusplus
+
+#include <assert.h>
+#include <stdint.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/**
+ * Function: VectorSearchTyped
+ * Usage: int i = VectorSearchTyped(&obstacles, key, CompareObstacles(), 0, true);
+ * ---------------------------
+ * Same as VectorSearch, for a vector whose elements are of type T.  The
+ * comparator is any callable taking (const T &key, const T &elem) and
+ * returning an int, such as a lambda or a function object, so that the
+ * compiler can inline it instead of calling a function pointer per element.
+ * An assert is raised if the size of T is not the element size of the vector.
+ */
+
+template <typename T, typename Compare>
+int VectorSearchTyped(const vector *v, const T &key, Compare compare, int startIndex, bool isSorted)
+{
+    assert(v->elemSize == (int)sizeof(T));
+    assert(startIndex >= 0 && startIndex <= v->logLength);
+
+    const T *elems = (const T *)v->elems;
+    if (isSorted) {
+        // branch-free lower bound : first element which is not less than the key
+        int n = v->logLength - startIndex;
+        if (n == 0) {
+            return -1;
+        }
+        const T *base = elems + startIndex;
+        while (n > 1) {
+            int half = n / 2;
+            base = compare(key, base[half]) > 0 ? base + half : base;
+            n -= half;
+        }
+        base += compare(key, *base) > 0;
+        return base < elems + v->logLength && compare(key, *base) == 0 ? (int)(base - elems) : -1;
+    }
+
+    for (int i = startIndex; i < v->logLength; i++) {
+        if (compare(key, elems[i]) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * Function: VectorFindScan
+ * ------------------------
+ * Linear scan for a key, unrolled by 4, used by VectorFind.
+ */
+
+template <typename T>
+inline int VectorFindScan(const T *elems, int start, int end, const T &key)
+{
+    int i = start;
+    for (; i + 4 <= end; i += 4) {
+        if (elems[i] == key) return i;
+        if (elems[i + 1] == key) return i + 1;
+        if (elems[i + 2] == key) return i + 2;
+        if (elems[i + 3] == key) return i + 3;
+    }
+    for (; i < end; i++) {
+        if (elems[i] == key) return i;
+    }
+    return -1;
+}
+
+#if defined(__SSE2__)
+/**
+ * Function: VectorFindScan
+ * ------------------------
+ * Linear scan for a 32-bit key, comparing 8 elements per iteration with SSE2.
+ */
+
+inline int VectorFindScan(const int32_t *elems, int start, int end, const int32_t &key)
+{
+    const __m128i needle = _mm_set1_epi32(key);
+    int i = start;
+    for (; i + 8 <= end; i += 8) {
+        __m128i a = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i *)(elems + i)), needle);
+        __m128i b = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i *)(elems + i + 4)), needle);
+        int mask = _mm_movemask_ps(_mm_castsi128_ps(a)) | (_mm_movemask_ps(_mm_castsi128_ps(b)) << 4);
+        if (mask != 0) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+    for (; i < end; i++) {
+        if (elems[i] == key) return i;
+    }
+    return -1;
+}
+
+inline int VectorFindScan(const uint32_t *elems, int start, int end, const uint32_t &key)
+{
+    return VectorFindScan((const int32_t *)elems, start, end, (const int32_t &)key);
+}
+#endif
+
+/**
+ * Function: VectorFind
+ * Usage: int i = VectorFind(&scores, 42, 0);
+ * --------------------
+ * Searches an unsorted vector of plain values of type T for the first element
+ * equal (operator ==) to the key, from startIndex to the end of the vector.
+ * Returns its position, or -1 if there is none.  The scan is unrolled, and
+ * uses SSE2 for 32-bit integers when the host supports it.  An assert is
+ * raised if the size of T is not the element size of the vector, or if
+ * startIndex is out of range as in VectorSearch.
+ */
+
+template <typename T>
+int VectorFind(const vector *v, const T &key, int startIndex)
+{
+    assert(v->elemSize == (int)sizeof(T));
+    assert(startIndex >= 0 && startIndex <= v->logLength);
+    return VectorFindScan((const T *)v->elems, startIndex, v->logLength, key);
+}
+
+#endif
+
+#endif